@@ -0,0 +1,440 @@
+// Microbenchmarks for the parser and decoders, run on synthetic data so no game files are needed.
+//
+//   nuex_bench [--filter <text>] [--min-time <seconds>] [--json <out.json>]
+//              [--compare <baseline.json>] [--threshold <percent>]
+//
+// --compare exits with 1 when a benchmark got slower than the baseline by more than the threshold (10% by default).
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "BinReader.hpp"
+#include "BinWriter.hpp"
+#include "Dxt.hpp"
+#include "SceneParser.hpp"
+#include "SynthScene.hpp"
+#include "logger.hpp"
+#include "umHalf.h"
+#include "utils.hpp"
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+struct BenchResult {
+    std::string name;
+    uint64_t iterations;
+    double nsPerOp;
+    double mbPerSecond; // 0 when the benchmark doesn't process a byte stream
+};
+
+struct BenchOptions {
+    std::string filter;
+    double minTime = 0.5;
+    std::string jsonPath;
+    std::string comparePath;
+    double threshold = 10;
+};
+
+// keeps results alive so the compiler can't drop the work
+static volatile uint64_t g_sink;
+
+static void consume(uint64_t value) {
+    g_sink = g_sink + value;
+}
+
+class Bench {
+  public:
+    explicit Bench(const BenchOptions& options) : m_options(options) {}
+
+    // `op` runs one operation, `bytes` is how much input it goes through
+    void run(const std::string& name, size_t bytes, const std::function<void()>& op) {
+        if (!m_options.filter.empty() && name.find(m_options.filter) == std::string::npos)
+            return;
+
+        op(); // warm up caches and lazy tables
+
+        uint64_t iterations = 1;
+        double seconds = 0;
+        while (true) {
+            auto start = Clock::now();
+            for (uint64_t i = 0; i < iterations; i++) {
+                op();
+            }
+            seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            if (seconds >= m_options.minTime || iterations >= (1ull << 40))
+                break;
+            // aim a bit past the minimum so the last round usually is the measured one
+            auto scale = seconds > 0 ? m_options.minTime * 1.2 / seconds : 10.0;
+            iterations = std::max(iterations + 1, (uint64_t)(iterations * std::min(scale, 10.0)));
+        }
+
+        BenchResult result = {name, iterations, seconds * 1e9 / iterations, bytes ? bytes * iterations / seconds / 1e6 : 0};
+        fmt::print("{:<46} {:>12} it {:>14.1f} ns/op", result.name, result.iterations, result.nsPerOp);
+        if (result.mbPerSecond > 0)
+            fmt::print(" {:>10.1f} MB/s", result.mbPerSecond);
+        fmt::print("\n");
+        m_results.push_back(result);
+    }
+
+    const std::vector<BenchResult>& results() const { return m_results; }
+
+  private:
+    BenchOptions m_options;
+    std::vector<BenchResult> m_results;
+};
+
+struct VertexLayout {
+    const char* name;
+    std::vector<std::pair<MeshValType, MeshVarType>> attribs;
+};
+
+static void writeVertexChunk(BinWriter& w, const VertexLayout& layout, uint32_t count, std::mt19937& rng) {
+    std::uniform_real_distribution<float> dist(-100.f, 100.f);
+    w.put<uint32_t>(1); // one buffer
+    w.put<uint32_t>(1); // not a reused one
+    w.put<uint32_t>(0); // flags
+    w.put<uint32_t>(count);
+    w.put<uint32_t>(layout.attribs.size());
+    for (const auto& [val, var] : layout.attribs) {
+        w.put<uint8_t>((uint8_t)val);
+        w.put<uint8_t>((uint8_t)var);
+        w.put<uint8_t>(0);
+    }
+    for (auto i = 0u; i < count; i++) {
+        for (const auto& [val, var] : layout.attribs) {
+            switch (var) {
+            case MeshVarType::Vec3f:
+                w.put(dist(rng));
+                w.put(dist(rng));
+                w.put(dist(rng));
+                break;
+            case MeshVarType::Vec4half:
+            case MeshVarType::Vec2half:
+                for (auto c = 0; c < (var == MeshVarType::Vec4half ? 4 : 2); c++) {
+                    w.putHalf(dist(rng) / 100.f);
+                }
+                break;
+            default:
+                for (auto c = 0u; c < utils::getVarSize(var); c++) {
+                    w.put<uint8_t>(rng());
+                }
+                break;
+            }
+        }
+    }
+    w.put<uint32_t>(0); // byteOffset
+}
+
+static void writeIndexChunk(BinWriter& w, uint32_t count, uint32_t vertexCount, std::mt19937& rng) {
+    w.put<uint32_t>(1); // not a reused buffer
+    w.put<uint32_t>(0); // flags
+    w.put<uint32_t>(count);
+    w.put<uint32_t>(2); // index size
+    for (auto i = 0u; i < count; i++) {
+        w.put<uint16_t>(rng() % vertexCount);
+    }
+    w.put<uint32_t>(0);     // indexOffset
+    w.put<uint32_t>(count); // indexCount
+    w.put<uint32_t>(0);     // vertexOffset
+    w.put<uint16_t>(0);
+    w.put<uint32_t>(vertexCount);
+}
+
+static std::string writeFile(const fs::path& dir, const std::string& name, const std::vector<uint8_t>& data) {
+    auto path = (dir / name).string();
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write((const char*)data.data(), data.size());
+    return path;
+}
+
+static void runBenchmarks(Bench& bench, const fs::path& dir) {
+    std::mt19937 rng(1234);
+
+    // BinReader::find over 16 MB with the needle at the very end
+    {
+        std::vector<uint8_t> data(16 * 1024 * 1024, 0xAB);
+        std::memcpy(data.data() + data.size() - 4, "HSEM", 4);
+        auto path = writeFile(dir, "find.bin", data);
+        auto reader = BinReader(path, Endianness::Big);
+        bench.run("binreader/find_16mb", data.size(), [&]() { consume(reader.find(std::string_view("HSEM", 4))); });
+    }
+
+    // operator>> one scalar at a time, as most of the parser reads
+    {
+        std::vector<uint8_t> data(4 * 1024 * 1024);
+        for (auto& b : data) {
+            b = rng();
+        }
+        auto path = writeFile(dir, "scalars.bin", data);
+        auto reader = BinReader(path, Endianness::Big);
+        bench.run("binreader/read_u32_be", data.size(), [&]() {
+            reader.seek(0);
+            uint32_t sum = 0;
+            for (size_t i = 0; i < data.size() / 4; i++) {
+                sum += reader.read<uint32_t>();
+            }
+            consume(sum);
+        });
+        bench.run("binreader/read_u16_be", data.size(), [&]() {
+            reader.seek(0);
+            uint32_t sum = 0;
+            for (size_t i = 0; i < data.size() / 2; i++) {
+                sum += reader.read<uint16_t>();
+            }
+            consume(sum);
+        });
+        reader.setEndianness(Endianness::Little);
+        bench.run("binreader/read_f32_le", data.size(), [&]() {
+            reader.seek(0);
+            float sum = 0;
+            for (size_t i = 0; i < data.size() / 4; i++) {
+                sum += reader.read<float>();
+            }
+            consume((uint64_t)sum);
+        });
+    }
+
+    // loadVertices per layout, loadIndices and the part streams genMesh uploads
+    const std::vector<VertexLayout> layouts = {
+        {"pos3f", {{MeshValType::Position, MeshVarType::Vec3f}}},
+        {"pos3f_norm_col_uv2h",
+         {{MeshValType::Position, MeshVarType::Vec3f},
+          {MeshValType::Normal, MeshVarType::Vec4mini},
+          {MeshValType::ColorSet0, MeshVarType::Col4char},
+          {MeshValType::UVSet1, MeshVarType::Vec2half}}},
+        {"pos4h_norm_uv4h_tangent",
+         {{MeshValType::Position, MeshVarType::Vec4half},
+          {MeshValType::Normal, MeshVarType::Vec4mini},
+          {MeshValType::UVSet1, MeshVarType::Vec4half},
+          {MeshValType::Tangent, MeshVarType::Vec4mini}}},
+    };
+    constexpr uint32_t vertexCount = 16384;
+    constexpr uint32_t indexCount = 65535;
+
+    for (const auto& layout : layouts) {
+        BinWriter w(Endianness::Big);
+        writeVertexChunk(w, layout, vertexCount, rng);
+        auto path = writeFile(dir, fmt::format("vertices_{}.bin", layout.name), w.data());
+        auto reader = BinReader(path, Endianness::Big);
+        bench.run(fmt::format("parser/load_vertices/{}", layout.name), w.data().size(), [&]() {
+            SceneParser parser;
+            MeshPart part;
+            reader.seek(0);
+            parser.loadVertices(reader, part);
+            consume(part.vertexBufferID);
+        });
+    }
+
+    {
+        BinWriter w(Endianness::Big);
+        writeIndexChunk(w, indexCount, vertexCount, rng);
+        auto path = writeFile(dir, "indices.bin", w.data());
+        auto reader = BinReader(path, Endianness::Big);
+        bench.run("parser/load_indices", w.data().size(), [&]() {
+            SceneParser parser;
+            MeshPart part;
+            reader.seek(0);
+            parser.loadIndices(reader, part);
+            consume(part.indexCount);
+        });
+    }
+
+    {
+        BinWriter w(Endianness::Big);
+        writeVertexChunk(w, layouts[1], vertexCount, rng);
+        writeIndexChunk(w, indexCount, vertexCount, rng);
+        auto path = writeFile(dir, "part.bin", w.data());
+        auto reader = BinReader(path, Endianness::Big);
+        SceneParser parser;
+        MeshPart part;
+        parser.loadVertices(reader, part);
+        parser.loadIndices(reader, part);
+        part.textureID = -1;
+        // the CPU half of Scene::genMesh, the upload itself needs a GL context
+        bench.run("parser/build_part", vertexCount * sizeof(MeshVertex) + indexCount * 2, [&]() {
+            SceneData data;
+            parser.buildPart(part, data);
+            consume(data.parts[0].positions.size());
+        });
+    }
+
+    // a whole synthetic file, TXGH to MESH
+    {
+        SynthOptions synthOptions;
+        synthOptions.parts = 64;
+        synthOptions.textures = 8;
+        auto path = (dir / "scene.gsc").string();
+        SynthStats stats;
+        if (synth::writeScene(path, synthOptions, &stats)) {
+            bench.run("parser/parse_scene", stats.bytes, [&]() {
+                SceneParser parser;
+                SceneData data;
+                parser.parse(path, data);
+                consume(data.parts.size());
+            });
+        }
+    }
+
+    // DDS sizing for a spread of sizes, mip counts and both block formats
+    {
+        std::vector<std::tuple<int, int, int>> sizes;
+        for (auto i = 0; i < 1024; i++) {
+            auto w = 1 << (rng() % 12), h = 1 << (rng() % 12);
+            sizes.emplace_back(w, h, 1 + rng() % 12);
+        }
+        bench.run("dds/stored_size x1024", 0, [&]() {
+            size_t total = 0;
+            for (const auto& [w, h, mips] : sizes) {
+                total += dxt::getStoredSize(w, h, mips, false) + dxt::getStoredSize(w, h, mips, true);
+            }
+            consume(total);
+        });
+    }
+
+    // attribute decoding helpers
+    {
+        std::vector<uint8_t> bytes(1024 * 1024);
+        for (auto& b : bytes) {
+            b = rng();
+        }
+        bench.run("utils/mini_float x1M", bytes.size(), [&]() {
+            float sum = 0;
+            for (auto b : bytes) {
+                sum += utils::getMiniFloat(b);
+            }
+            consume((uint64_t)sum);
+        });
+
+        std::vector<half> halves(1024 * 1024);
+        std::vector<float> floats(halves.size());
+        for (size_t i = 0; i < halves.size(); i++) {
+            floats[i] = (float)(rng() % 20000) / 100.f - 100.f;
+            halves[i] = floats[i];
+        }
+        bench.run("half/to_float x1M", halves.size() * 2, [&]() {
+            float sum = 0;
+            for (auto h : halves) {
+                sum += (float)h;
+            }
+            consume((uint64_t)sum);
+        });
+        bench.run("half/from_float x1M", floats.size() * 4, [&]() {
+            for (size_t i = 0; i < floats.size(); i++) {
+                halves[i] = floats[i];
+            }
+            uint16_t bits;
+            std::memcpy(&bits, &halves.back(), 2);
+            consume(bits);
+        });
+    }
+}
+
+static bool writeJson(const std::string& path, const std::vector<BenchResult>& results) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out)
+        return false;
+    // one benchmark per line, readBaseline relies on that
+    out << "{\"benchmarks\":[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& r = results[i];
+        out << fmt::format("  {{\"name\":\"{}\",\"iterations\":{},\"ns_per_op\":{:.3f},\"mb_per_s\":{:.3f}}}{}\n", r.name, r.iterations,
+                           r.nsPerOp, r.mbPerSecond, i + 1 < results.size() ? "," : "");
+    }
+    out << "]}\n";
+    return (bool)out;
+}
+
+// name -> ns/op from a file writeJson produced
+static std::unordered_map<std::string, double> readBaseline(const std::string& path) {
+    std::unordered_map<std::string, double> baseline;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        auto name = line.find("\"name\":\"");
+        auto ns = line.find("\"ns_per_op\":");
+        if (name == std::string::npos || ns == std::string::npos)
+            continue;
+        name += 8;
+        auto nameEnd = line.find('"', name);
+        baseline[line.substr(name, nameEnd - name)] = std::stod(line.substr(ns + 12));
+    }
+    return baseline;
+}
+
+static int compare(const std::vector<BenchResult>& results, const BenchOptions& options) {
+    auto baseline = readBaseline(options.comparePath);
+    if (baseline.empty()) {
+        logE("No benchmarks in {}", options.comparePath);
+        return 2;
+    }
+
+    auto regressions = 0;
+    fmt::print("\n{:<46} {:>14} {:>14} {:>9}\n", "benchmark", "baseline ns", "current ns", "change");
+    for (const auto& r : results) {
+        auto it = baseline.find(r.name);
+        if (it == baseline.end()) {
+            fmt::print("{:<46} {:>14} {:>14.1f} {:>9}\n", r.name, "-", r.nsPerOp, "new");
+            continue;
+        }
+        auto change = (r.nsPerOp / it->second - 1) * 100;
+        auto regressed = change > options.threshold;
+        regressions += regressed;
+        fmt::print("{:<46} {:>14.1f} {:>14.1f} {:>+8.1f}%{}\n", r.name, it->second, r.nsPerOp, change, regressed ? "  REGRESSED" : "");
+    }
+
+    if (regressions > 0) {
+        fmt::print("\n{} benchmarks regressed by more than {}%\n", regressions, options.threshold);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    for (auto i = 1; i < argc; i++) {
+        auto arg = std::string_view(argv[i]);
+        auto hasValue = i + 1 < argc;
+        if (arg == "--filter" && hasValue) {
+            options.filter = argv[++i];
+        } else if (arg == "--min-time" && hasValue) {
+            options.minTime = std::stod(argv[++i]);
+        } else if (arg == "--json" && hasValue) {
+            options.jsonPath = argv[++i];
+        } else if (arg == "--compare" && hasValue) {
+            options.comparePath = argv[++i];
+        } else if (arg == "--threshold" && hasValue) {
+            options.threshold = std::stod(argv[++i]);
+        } else {
+            fmt::print("Usage: {} [--filter <text>] [--min-time <seconds>] [--json <out.json>] [--compare <baseline.json>] "
+                       "[--threshold <percent>]\n",
+                       argv[0]);
+            return 2;
+        }
+    }
+
+    logger::level = logger::Level::Warn;
+
+    auto dir = fs::temp_directory_path() / "nuex_bench_data";
+    fs::create_directories(dir);
+
+    Bench bench(options);
+    runBenchmarks(bench, dir);
+
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+
+    if (!options.jsonPath.empty() && !writeJson(options.jsonPath, bench.results())) {
+        logE("Couldn't write {}", options.jsonPath);
+        return 2;
+    }
+    if (!options.comparePath.empty())
+        return compare(bench.results(), options);
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include "Batch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <vector>
+#include "GltfExporter.hpp"
+#include "SceneParser.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+#include "logger.hpp"
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace batch {
+    struct FileResult {
+        std::string path;
+        size_t size = 0;
+        double ms = 0;
+        double exportMs = 0;
+        size_t parts = 0;
+        size_t textures = 0;
+        bool ok = false;
+        std::string error;
+    };
+
+    static bool isSceneFile(const fs::path& path) {
+        auto ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+        return ext == ".gsc" || ext == ".ghg";
+    }
+
+    static std::vector<fs::path> collectFiles(const fs::path& dir) {
+        std::vector<fs::path> files;
+        std::error_code ec;
+        for (auto it = fs::recursive_directory_iterator(dir, fs::directory_options::skip_permission_denied, ec);
+             it != fs::recursive_directory_iterator(); it.increment(ec)) {
+            if (ec)
+                break;
+            if (it->is_regular_file(ec) && isSceneFile(it->path()))
+                files.push_back(it->path());
+        }
+        // biggest first so a huge level doesn't start last and stretch the run
+        std::sort(files.begin(), files.end(), [](const fs::path& a, const fs::path& b) {
+            std::error_code ec;
+            return fs::file_size(a, ec) > fs::file_size(b, ec);
+        });
+        return files;
+    }
+
+    int run(const BatchOptions& options) {
+        std::error_code ec;
+        if (!fs::is_directory(options.dir, ec)) {
+            logE("BATCH: {} is not a directory", options.dir);
+            return 2;
+        }
+
+        auto files = collectFiles(options.dir);
+        if (files.empty()) {
+            logW("BATCH: No .gsc/.ghg files under {}", options.dir);
+            return 0;
+        }
+
+        logger::level = logger::Level::Warn;
+        fmt::print("Processing {} files on {} threads\n", files.size(), ThreadPool::shared().size() + 1);
+
+        std::vector<FileResult> results(files.size());
+        std::mutex printMutex;
+        if (!options.tracePath.empty())
+            trace::start();
+        auto start = Clock::now();
+
+        // every thread claims the next file one at a time, so the biggest ones start first instead of landing in one
+        // thread's chunk. Each parse and export still spreads its own work over the pool
+        std::atomic<size_t> nextFile = 0;
+        auto worker = [&]() {
+            for (auto i = nextFile++; i < files.size(); i = nextFile++) {
+                auto& result = results[i];
+                std::error_code sizeError;
+                result.path = files[i].string();
+                result.size = fs::file_size(files[i], sizeError);
+
+                auto fileStart = Clock::now();
+                NUEX_TRACE_SCOPE("file");
+                NUEX_TRACE_BYTES(result.size);
+                try {
+                    SceneData data;
+                    ParseError error;
+                    result.ok = SceneParser().parse(result.path, data, &error);
+                    result.parts = data.parts.size();
+                    result.textures = data.textures.size();
+                    result.ms = std::chrono::duration<double, std::milli>(Clock::now() - fileStart).count();
+                    if (!result.ok)
+                        result.error = error.message();
+
+                    if (result.ok && !options.exportDir.empty()) {
+                        auto exportStart = Clock::now();
+                        auto target = fs::path(options.exportDir) / fs::relative(files[i], options.dir, sizeError);
+                        target.replace_extension(".glb");
+                        fs::create_directories(target.parent_path(), sizeError);
+                        if (!gltf::exportScene(data, target.string(), {options.pngTextures})) {
+                            result.ok = false;
+                            result.error = fmt::format("couldn't export to {}", target.string());
+                        }
+                        result.exportMs = std::chrono::duration<double, std::milli>(Clock::now() - exportStart).count();
+                    }
+                } catch (const std::exception& e) {
+                    result.error = e.what();
+                    result.ms = std::chrono::duration<double, std::milli>(Clock::now() - fileStart).count();
+                }
+
+                std::lock_guard lock(printMutex);
+                if (result.ok && !options.exportDir.empty()) {
+                    fmt::print("ok    {:9.1f} ms {:8.2f} MB  {} ({} parts, {} textures, exported in {:.1f} ms)\n", result.ms,
+                               result.size / 1e6, result.path, result.parts, result.textures, result.exportMs);
+                } else if (result.ok) {
+                    fmt::print("ok    {:9.1f} ms {:8.2f} MB  {} ({} parts, {} textures)\n", result.ms, result.size / 1e6,
+                               result.path, result.parts, result.textures);
+                } else {
+                    fmt::print("FAIL  {:9.1f} ms {:8.2f} MB  {}: {}\n", result.ms, result.size / 1e6, result.path, result.error);
+                }
+            }
+        };
+        std::vector<std::future<void>> helpers;
+        for (auto i = 0u; i < ThreadPool::shared().size(); i++) {
+            helpers.push_back(ThreadPool::shared().submit(worker));
+        }
+        worker();
+        for (auto& helper : helpers) {
+            helper.get();
+        }
+
+        auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        logger::flush();
+        if (!options.tracePath.empty()) {
+            trace::stop();
+            trace::write(options.tracePath);
+            fmt::print("\nTrace written to {}\n", options.tracePath);
+            trace::printSummary();
+        }
+        size_t bytes = 0, failed = 0;
+        for (const auto& result : results) {
+            bytes += result.size;
+            failed += !result.ok;
+        }
+
+        fmt::print("\n{} files, {} failed, {:.2f} MB in {:.2f} s: {:.1f} files/s, {:.1f} MB/s\n", files.size(), failed, bytes / 1e6,
+                   seconds, files.size() / seconds, bytes / 1e6 / seconds);
+        if (failed > 0) {
+            fmt::print("Failed:\n");
+            for (const auto& result : results) {
+                if (!result.ok)
+                    fmt::print("  {}: {}\n", result.path, result.error);
+            }
+        }
+
+        return failed > 0 ? 1 : 0;
+    }
+} // namespace batch
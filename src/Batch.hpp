@@ -0,0 +1,16 @@
+#pragma once
+#include <string>
+
+struct BatchOptions {
+    std::string dir;
+    std::string exportDir; // when set, every file is also exported to .glb here, mirroring the tree under `dir`
+    bool pngTextures = false;
+    std::string tracePath; // when set, the run is traced (see Trace.hpp) and a per-phase summary printed
+};
+
+namespace batch {
+    // `NuExplorer --batch <dir> [--export <outdir> [--png]] [--trace <out.json>]`: parses (and exports) every .gsc/.ghg under `dir` on the
+    // thread pool, no window involved.
+    // Prints per-file timings and failures plus overall throughput, returns the process exit code
+    int run(const BatchOptions& options);
+} // namespace batch
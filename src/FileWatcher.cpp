@@ -0,0 +1,107 @@
+#include "FileWatcher.hpp"
+
+#include <filesystem>
+#include "logger.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+static std::string absolutePath(const std::string& path) {
+    std::error_code error;
+    auto absolute = std::filesystem::absolute(path, error);
+    return (error ? std::filesystem::path(path) : absolute).lexically_normal().string();
+}
+
+FileWatcher::FileWatcher() : m_fd(-1) {
+#ifdef __linux__
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0)
+        logW("WATCH: inotify isn't available, loaded files won't be reloaded on change");
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+    if (m_fd >= 0)
+        close(m_fd);
+#endif
+}
+
+void FileWatcher::add(const std::string& path) {
+    if (m_fd < 0)
+        return;
+    auto absolute = absolutePath(path);
+    if (!m_files.try_emplace(absolute, path).second)
+        return;
+
+#ifdef __linux__
+    auto dir = std::filesystem::path(absolute).parent_path().string();
+    auto it = m_dirs.find(dir);
+    if (it == m_dirs.end()) {
+        auto wd = inotify_add_watch(m_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO);
+        if (wd < 0) {
+            logW("WATCH: Couldn't watch {}", dir);
+            m_files.erase(absolute);
+            return;
+        }
+        it = m_dirs.emplace(dir, Directory {wd, 0}).first;
+        m_wdDirs[wd] = dir;
+    }
+    it->second.files++;
+#endif
+}
+
+void FileWatcher::remove(const std::string& path) {
+    auto absolute = absolutePath(path);
+    if (!m_files.erase(absolute))
+        return;
+    m_changed.erase(absolute);
+
+#ifdef __linux__
+    auto it = m_dirs.find(std::filesystem::path(absolute).parent_path().string());
+    if (it != m_dirs.end() && --it->second.files == 0) {
+        inotify_rm_watch(m_fd, it->second.wd);
+        m_wdDirs.erase(it->second.wd);
+        m_dirs.erase(it);
+    }
+#endif
+}
+
+std::vector<std::string> FileWatcher::poll(std::chrono::milliseconds settle) {
+    std::vector<std::string> ready;
+    if (m_fd < 0)
+        return ready;
+
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        auto length = read(m_fd, buffer, sizeof(buffer));
+        if (length <= 0)
+            break;
+        for (auto ptr = buffer; ptr < buffer + length;) {
+            auto event = (const inotify_event*)ptr;
+            ptr += sizeof(inotify_event) + event->len;
+
+            auto dir = m_wdDirs.find(event->wd);
+            if (dir == m_wdDirs.end() || event->len == 0)
+                continue;
+            auto path = (std::filesystem::path(dir->second) / event->name).string();
+            if (m_files.contains(path))
+                m_changed[path] = Clock::now();
+        }
+    }
+#endif
+
+    auto now = Clock::now();
+    for (auto it = m_changed.begin(); it != m_changed.end();) {
+        if (now - it->second < settle) {
+            it++;
+            continue;
+        }
+        ready.push_back(m_files[it->first]);
+        it = m_changed.erase(it);
+    }
+    return ready;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Reports watched files that were written to, through inotify watches on their directories: editors and
+// exporters often save by renaming a temporary file over the original, which a watch on the file itself
+// would lose track of. Linux only, elsewhere nothing is ever reported
+class FileWatcher {
+  public:
+    FileWatcher();
+    ~FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    void add(const std::string& path);
+    void remove(const std::string& path);
+
+    // files (as passed to add()) whose last write is at least `settle` old, so a file is reported once per
+    // burst of writes rather than halfway through one. Writes are timed when a poll picks them up, call it often
+    std::vector<std::string> poll(std::chrono::milliseconds settle);
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Directory {
+        int wd;
+        unsigned int files; // watched files in it
+    };
+
+    int m_fd;
+    std::unordered_map<std::string, Directory> m_dirs; // by absolute path
+    std::unordered_map<int, std::string> m_wdDirs;
+    std::unordered_map<std::string, std::string> m_files; // absolute path -> path as added
+    std::unordered_map<std::string, Clock::time_point> m_changed; // absolute path -> last write
+};
@@ -0,0 +1,46 @@
+#include "Frustum.hpp"
+
+#include <cmath>
+#include <raymath.h>
+
+static Vector4 normalizePlane(float a, float b, float c, float d) {
+    auto len = std::sqrt(a * a + b * b + c * c);
+    return {a / len, b / len, c / len, d / len};
+}
+
+Frustum Frustum::fromMatrix(const Matrix& m) {
+    // Gribb-Hartmann, rows of the clip matrix are (m0 m4 m8 m12), (m1 m5 m9 m13) etc
+    Frustum f;
+    f.planes[0] = normalizePlane(m.m3 + m.m0, m.m7 + m.m4, m.m11 + m.m8, m.m15 + m.m12);
+    f.planes[1] = normalizePlane(m.m3 - m.m0, m.m7 - m.m4, m.m11 - m.m8, m.m15 - m.m12);
+    f.planes[2] = normalizePlane(m.m3 + m.m1, m.m7 + m.m5, m.m11 + m.m9, m.m15 + m.m13);
+    f.planes[3] = normalizePlane(m.m3 - m.m1, m.m7 - m.m5, m.m11 - m.m9, m.m15 - m.m13);
+    f.planes[4] = normalizePlane(m.m3 + m.m2, m.m7 + m.m6, m.m11 + m.m10, m.m15 + m.m14);
+    f.planes[5] = normalizePlane(m.m3 - m.m2, m.m7 - m.m6, m.m11 - m.m10, m.m15 - m.m14);
+    return f;
+}
+
+Frustum Frustum::fromMatrices(const Matrix& view, const Matrix& projection) {
+    return fromMatrix(MatrixMultiply(view, projection));
+}
+
+bool Frustum::containsSphere(Vector3 center, float radius) const {
+    for (const auto& p : planes) {
+        if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::containsBox(const BoundingBox& box) const {
+    for (const auto& p : planes) {
+        // the corner furthest along the plane normal
+        auto x = p.x >= 0 ? box.max.x : box.min.x;
+        auto y = p.y >= 0 ? box.max.y : box.min.y;
+        auto z = p.z >= 0 ? box.max.z : box.min.z;
+        if (p.x * x + p.y * y + p.z * z + p.w < 0)
+            return false;
+    }
+    return true;
+}
+
@@ -0,0 +1,14 @@
+#pragma once
+#include <raylib.h>
+
+struct Frustum {
+    // left, right, bottom, top, near, far. xyz is the normal pointing inside, w the distance
+    Vector4 planes[6];
+
+    // expects the combined view-projection matrix (raylib order: MatrixMultiply(view, projection))
+    static Frustum fromMatrix(const Matrix& viewProj);
+    static Frustum fromMatrices(const Matrix& view, const Matrix& projection);
+
+    bool containsSphere(Vector3 center, float radius) const;
+    bool containsBox(const BoundingBox& box) const;
+};
@@ -0,0 +1,329 @@
+#include "IndirectRenderer.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <raymath.h>
+#include "gl.hpp"
+#include "logger.hpp"
+
+static const char* cullCS = R"(#version 430
+layout(local_size_x = 64) in;
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+layout(std430, binding = 0) readonly buffer Bounds {
+    vec4 bounds[]; // min, max
+};
+layout(std430, binding = 1) buffer Commands {
+    DrawCommand commands[];
+};
+uniform vec4 planes[6];
+uniform uint commandCount;
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= commandCount)
+        return;
+    vec3 bmin = bounds[i * 2].xyz;
+    vec3 bmax = bounds[i * 2 + 1].xyz;
+    bool visible = true;
+    for (int p = 0; p < 6; p++) {
+        vec3 corner = mix(bmin, bmax, greaterThanEqual(planes[p].xyz, vec3(0.0)));
+        if (dot(planes[p].xyz, corner) + planes[p].w < 0.0)
+            visible = false;
+    }
+    commands[i].instanceCount = visible ? 1u : 0u;
+}
+)";
+
+static const char* arrayVS = R"(#version 330
+in vec3 vertexPosition;
+in vec2 vertexTexCoord;
+in vec4 vertexColor;
+layout(location = 6) in float vertexLayer;
+uniform mat4 mvp;
+out vec3 fragTexCoord;
+out vec4 fragColor;
+void main() {
+    fragTexCoord = vec3(vertexTexCoord, vertexLayer);
+    fragColor = vertexColor;
+    gl_Position = mvp * vec4(vertexPosition, 1.0);
+}
+)";
+
+// same math as raylib's default fragment shader, only the sampler differs
+static const char* arrayFS = R"(#version 330
+in vec3 fragTexCoord;
+in vec4 fragColor;
+uniform sampler2DArray texture0;
+uniform vec4 colDiffuse;
+out vec4 finalColor;
+void main() {
+    finalColor = texture(texture0, fragTexCoord) * colDiffuse * fragColor;
+}
+)";
+
+// attribute slot for the per-part layer, past the ones UploadMesh uses
+constexpr unsigned int layerAttrib = 6;
+
+IndirectRenderer::IndirectRenderer()
+    : m_vao(0), m_vbos {0, 0, 0, 0}, m_ebo(0), m_layerBuffer(0), m_indirectBuffer(0), m_boundsBuffer(0), m_cullProgram(0),
+      m_planesLoc(-1), m_countLoc(-1), m_arrayShader(0), m_arrayMvpLoc(-1), m_arrayDiffuseLoc(-1), m_arrayTextureLoc(-1),
+      m_drawCalls(0) {}
+
+IndirectRenderer::~IndirectRenderer() {
+    reset();
+    if (m_cullProgram != 0)
+        glDeleteProgram(m_cullProgram);
+    if (m_arrayShader != 0)
+        rlUnloadShaderProgram(m_arrayShader);
+}
+
+bool IndirectRenderer::isSupported() {
+    if (GLAD_GL_VERSION_4_3 && glMultiDrawElementsIndirect != nullptr && glDispatchCompute != nullptr)
+        return true;
+
+    logW("INDIRECT: Multi-draw indirect needs GL 4.3, not available on {} ({})", (const char*)glGetString(GL_RENDERER),
+         (const char*)glGetString(GL_VERSION));
+    return false;
+}
+
+void IndirectRenderer::reset() {
+    if (m_vao == 0)
+        return;
+
+    rlUnloadVertexArray(m_vao);
+    for (auto vbo : m_vbos) {
+        rlUnloadVertexBuffer(vbo);
+    }
+    rlUnloadVertexBuffer(m_ebo);
+    if (m_layerBuffer != 0)
+        rlUnloadVertexBuffer(m_layerBuffer);
+    glDeleteBuffers(1, &m_indirectBuffer);
+    glDeleteBuffers(1, &m_boundsBuffer);
+
+    m_vao = 0;
+    m_layerBuffer = 0;
+    m_commands.clear();
+    m_commandBounds.clear();
+    m_partCommands.clear();
+    m_groups.clear();
+}
+
+void IndirectRenderer::build(const std::vector<Model>& models, const std::vector<BoundingBox>& bounds, const TextureArrays* arrays) {
+    reset();
+
+    // what a group binds: the diffuse texture, or the array holding it
+    auto textureOf = [&](size_t i) {
+        auto texture = models[i].materials[0].maps[MATERIAL_MAP_DIFFUSE].texture.id;
+        return arrays ? arrays->find(texture).array : texture;
+    };
+
+    // lazy geometry that isn't resident yet gets an empty command
+    static const Mesh noMesh = {0};
+    auto meshOf = [&](size_t i) -> const Mesh& { return models[i].meshCount > 0 ? models[i].meshes[0] : noMesh; };
+
+    // commands are ordered by texture so that each group is one contiguous range
+    std::vector<unsigned int> order(models.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](auto a, auto b) { return textureOf(a) < textureOf(b); });
+
+    size_t vertexCount = 0, indexCount = 0;
+    for (auto i = 0u; i < models.size(); i++) {
+        vertexCount += meshOf(i).vertexCount;
+        indexCount += meshOf(i).triangleCount * 3;
+    }
+
+    std::vector<float> positions, texcoords, normals;
+    std::vector<uint8_t> colors;
+    std::vector<unsigned short> indices;
+    positions.reserve(vertexCount * 3);
+    normals.reserve(vertexCount * 3);
+    texcoords.reserve(vertexCount * 2);
+    colors.reserve(vertexCount * 4);
+    indices.reserve(indexCount);
+
+    m_partCommands.resize(models.size());
+    for (auto partIdx : order) {
+        const auto& mesh = meshOf(partIdx);
+        auto texture = textureOf(partIdx);
+
+        if (m_groups.empty() || m_groups.back().texture != texture)
+            m_groups.push_back({texture, (unsigned int)m_commands.size(), 0});
+        m_groups.back().commandCount++;
+
+        m_partCommands[partIdx] = m_commands.size();
+        m_commands.push_back({(uint32_t)mesh.triangleCount * 3, 1, (uint32_t)indices.size(), (int32_t)(positions.size() / 3),
+                              partIdx});
+        m_commandBounds.push_back(bounds[partIdx]);
+
+        positions.insert(positions.end(), mesh.vertices, mesh.vertices + mesh.vertexCount * 3);
+        texcoords.insert(texcoords.end(), mesh.texcoords, mesh.texcoords + mesh.vertexCount * 2);
+        normals.insert(normals.end(), mesh.normals, mesh.normals + mesh.vertexCount * 3);
+        colors.insert(colors.end(), mesh.colors, mesh.colors + mesh.vertexCount * 4);
+        indices.insert(indices.end(), mesh.indices, mesh.indices + mesh.triangleCount * 3);
+    }
+
+    // same attribute layout as UploadMesh, so the default shader works unchanged
+    m_vao = rlLoadVertexArray();
+    rlEnableVertexArray(m_vao);
+    m_vbos[0] = rlLoadVertexBuffer(positions.data(), positions.size() * sizeof(float), false);
+    rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 3, RL_FLOAT, false, 0, 0);
+    rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION);
+    m_vbos[1] = rlLoadVertexBuffer(texcoords.data(), texcoords.size() * sizeof(float), false);
+    rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD, 2, RL_FLOAT, false, 0, 0);
+    rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD);
+    m_vbos[2] = rlLoadVertexBuffer(normals.data(), normals.size() * sizeof(float), false);
+    rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_NORMAL, 3, RL_FLOAT, false, 0, 0);
+    rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_NORMAL);
+    m_vbos[3] = rlLoadVertexBuffer(colors.data(), colors.size(), false);
+    rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR, 4, RL_UNSIGNED_BYTE, true, 0, 0);
+    rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR);
+    m_ebo = rlLoadVertexBufferElement(indices.data(), indices.size() * sizeof(unsigned short), false);
+
+    if (arrays) {
+        // indexed by part through baseInstance
+        std::vector<float> layers(models.size());
+        for (auto i = 0u; i < models.size(); i++) {
+            layers[i] = arrays->find(models[i].materials[0].maps[MATERIAL_MAP_DIFFUSE].texture.id).layer;
+        }
+        m_layerBuffer = rlLoadVertexBuffer(layers.data(), layers.size() * sizeof(float), false);
+        rlSetVertexAttribute(layerAttrib, 1, RL_FLOAT, false, 0, 0);
+        rlSetVertexAttributeDivisor(layerAttrib, 1);
+        rlEnableVertexAttribute(layerAttrib);
+    }
+    rlDisableVertexArray();
+
+    glGenBuffers(1, &m_indirectBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commands.size() * sizeof(DrawCommand), m_commands.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    std::vector<float> boundsData;
+    boundsData.reserve(m_commandBounds.size() * 8);
+    for (const auto& box : m_commandBounds) {
+        boundsData.insert(boundsData.end(), {box.min.x, box.min.y, box.min.z, 0.f, box.max.x, box.max.y, box.max.z, 0.f});
+    }
+    glGenBuffers(1, &m_boundsBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_boundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, boundsData.size() * sizeof(float), boundsData.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    logD("INDIRECT: Pooled {} parts ({} vertices, {} indices) into {} {} groups", models.size(), positions.size() / 3,
+         indices.size(), m_groups.size(), arrays ? "texture array" : "material");
+}
+
+unsigned int IndirectRenderer::cullCPU(const Frustum& frustum) {
+    unsigned int visible = 0;
+    for (auto i = 0u; i < m_commands.size(); i++) {
+        m_commands[i].instanceCount = frustum.containsBox(m_commandBounds[i]);
+        visible += m_commands[i].instanceCount;
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, m_commands.size() * sizeof(DrawCommand), m_commands.data());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    return visible;
+}
+
+bool IndirectRenderer::loadCullShader() {
+    auto shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &cullCS, nullptr);
+    glCompileShader(shader);
+
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        logE("INDIRECT: Failed to compile the culling shader: {}", log);
+        glDeleteShader(shader);
+        return false;
+    }
+
+    m_cullProgram = glCreateProgram();
+    glAttachShader(m_cullProgram, shader);
+    glLinkProgram(m_cullProgram);
+    glDeleteShader(shader);
+
+    glGetProgramiv(m_cullProgram, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        logE("INDIRECT: Failed to link the culling shader");
+        glDeleteProgram(m_cullProgram);
+        m_cullProgram = 0;
+        return false;
+    }
+
+    m_planesLoc = glGetUniformLocation(m_cullProgram, "planes");
+    m_countLoc = glGetUniformLocation(m_cullProgram, "commandCount");
+    return true;
+}
+
+void IndirectRenderer::cullGPU(const Frustum& frustum) {
+    if (m_cullProgram == 0 && !loadCullShader()) {
+        cullCPU(frustum);
+        return;
+    }
+
+    glUseProgram(m_cullProgram);
+    glUniform4fv(m_planesLoc, 6, (const float*)frustum.planes);
+    glUniform1ui(m_countLoc, m_commands.size());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_boundsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_indirectBuffer);
+    glDispatchCompute((m_commands.size() + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+    glUseProgram(0);
+}
+
+void IndirectRenderer::loadArrayShader() {
+    m_arrayShader = rlLoadShaderCode(arrayVS, arrayFS);
+    m_arrayMvpLoc = rlGetLocationUniform(m_arrayShader, "mvp");
+    m_arrayDiffuseLoc = rlGetLocationUniform(m_arrayShader, "colDiffuse");
+    m_arrayTextureLoc = rlGetLocationUniform(m_arrayShader, "texture0");
+}
+
+void IndirectRenderer::draw() {
+    m_drawCalls = 0;
+
+    auto arrays = usesTextureArrays();
+    if (arrays) {
+        if (m_arrayShader == 0)
+            loadArrayShader();
+        rlEnableShader(m_arrayShader);
+        rlSetUniformMatrix(m_arrayMvpLoc, MatrixMultiply(MatrixMultiply(rlGetMatrixTransform(), rlGetMatrixModelview()),
+                                                         rlGetMatrixProjection()));
+        float diffuse[4] = {1.f, 1.f, 1.f, 1.f};
+        rlSetUniform(m_arrayDiffuseLoc, diffuse, RL_SHADER_UNIFORM_VEC4, 1);
+        int slot = 0;
+        rlSetUniform(m_arrayTextureLoc, &slot, RL_SHADER_UNIFORM_INT, 1);
+        rlActiveTextureSlot(0);
+    }
+
+    rlEnableVertexArray(m_vao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+
+    for (const auto& group : m_groups) {
+        if (arrays) {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, group.texture);
+        } else {
+            rlEnableTexture(group.texture);
+        }
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT,
+                                    (const void*)(group.firstCommand * sizeof(DrawCommand)), group.commandCount, 0);
+        m_drawCalls++;
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    rlDisableVertexArray();
+
+    if (arrays) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        rlDisableShader();
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <raylib.h>
+#include "Frustum.hpp"
+#include "TextureArrays.hpp"
+
+// GL 4.3 path: every part lives in one shared vertex/index pool and each material group is
+// submitted with a single glMultiDrawElementsIndirect. Visibility is written straight into the
+// indirect command buffer, either from the CPU or by a compute shader.
+class IndirectRenderer {
+  public:
+    IndirectRenderer();
+    ~IndirectRenderer();
+
+    // needs a current GL context. False under contexts older than 4.3
+    static bool isSupported();
+
+    // with `arrays`, parts are grouped by texture array and pick their layer through an instanced attribute,
+    // so one multi-draw covers every material stored in the same array
+    void build(const std::vector<Model>& models, const std::vector<BoundingBox>& bounds, const TextureArrays* arrays = nullptr);
+    void reset();
+    bool isBuilt() const { return m_vao != 0; }
+    bool usesTextureArrays() const { return m_layerBuffer != 0; }
+    size_t partCount() const { return m_partCommands.size(); }
+
+    // returns the number of visible parts
+    unsigned int cullCPU(const Frustum& frustum);
+    void cullGPU(const Frustum& frustum);
+    // expects the default shader to be bound with its uniforms set (see LeanRenderer::begin), unless
+    // texture arrays are used, then it binds its own shader
+    void draw();
+
+    unsigned int lastDrawCalls() const { return m_drawCalls; }
+
+  private:
+    // layout defined by GL, see glMultiDrawElementsIndirect
+    struct DrawCommand {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t baseVertex;
+        uint32_t baseInstance;
+    };
+
+    struct Group {
+        unsigned int texture;
+        unsigned int firstCommand;
+        unsigned int commandCount;
+    };
+
+    bool loadCullShader();
+    void loadArrayShader();
+
+    std::vector<DrawCommand> m_commands;
+    std::vector<BoundingBox> m_commandBounds; // in command order
+    std::vector<unsigned int> m_partCommands;  // part index -> command index
+    std::vector<Group> m_groups;
+
+    unsigned int m_vao;
+    unsigned int m_vbos[4];
+    unsigned int m_ebo;
+    unsigned int m_layerBuffer;
+    unsigned int m_indirectBuffer;
+    unsigned int m_boundsBuffer;
+    unsigned int m_cullProgram;
+    int m_planesLoc;
+    int m_countLoc;
+    unsigned int m_arrayShader;
+    int m_arrayMvpLoc;
+    int m_arrayDiffuseLoc;
+    int m_arrayTextureLoc;
+    unsigned int m_drawCalls;
+};
@@ -0,0 +1,178 @@
+#include "LazyGeometry.hpp"
+
+#include "MeshCache.hpp"
+#include "SceneParser.hpp"
+#include "ThreadPool.hpp"
+#include "logger.hpp"
+
+// like LazyTextures, keeps a single frame from stalling on uploads. Parts are small, so more decodes
+// are kept going at once
+constexpr size_t maxUploadBytesPerFrame = 16 * 1024 * 1024;
+constexpr unsigned int maxDecodesInFlight = 16;
+
+LazyGeometry::LazyGeometry(Residency& residency) : m_residency(residency), m_count(0), m_generation(0) {}
+
+LazyGeometry::~LazyGeometry() {
+    reset();
+}
+
+unsigned int LazyGeometry::add(const std::string& filename, const ScenePart& part) {
+    auto entry = std::make_unique<Entry>();
+    entry->filename = filename;
+    entry->geometry = part.geometry;
+    entry->mesh = {};
+    entry->resident = false;
+    entry->blended = false;
+    entry->failed = false;
+    entry->requested = Request::None;
+
+    unsigned int handle;
+    if (!m_free.empty()) {
+        handle = m_free.back();
+        m_free.pop_back();
+        m_entries[handle] = std::move(entry);
+    } else {
+        handle = m_entries.size();
+        m_entries.push_back(std::move(entry));
+    }
+    m_count++;
+    m_stats.parts = m_count;
+    return handle;
+}
+
+void LazyGeometry::remove(unsigned int handle) {
+    // a decode still running works on its own copies, its result is dropped with the future
+    unload(handle);
+    m_residency.forget(Residency::Kind::Mesh, handle);
+    m_entries[handle].reset();
+    m_free.push_back(handle);
+    m_count--;
+    m_stats.parts = m_count;
+}
+
+void LazyGeometry::reset() {
+    for (auto handle = 0u; handle < m_entries.size(); handle++) {
+        if (!m_entries[handle])
+            continue;
+        unload(handle);
+        m_residency.forget(Residency::Kind::Mesh, handle);
+    }
+    m_entries.clear();
+    m_free.clear();
+    m_count = 0;
+    m_stats = {};
+}
+
+void LazyGeometry::unload(unsigned int handle) {
+    auto& entry = *m_entries[handle];
+    if (!entry.resident)
+        return;
+    if (!MeshCache::shared().release(entry.mesh))
+        UnloadMesh(entry.mesh);
+    entry.mesh = {};
+    entry.resident = false;
+    m_residency.remove(Residency::Kind::Mesh, handle);
+    m_generation++;
+}
+
+void LazyGeometry::request(unsigned int handle, bool prefetch) {
+    auto& entry = *m_entries[handle];
+    if (!prefetch) {
+        entry.requested = Request::Visible;
+        m_residency.touch(Residency::Kind::Mesh, handle);
+    } else if (entry.requested == Request::None) {
+        entry.requested = Request::Prefetch;
+    }
+}
+
+void LazyGeometry::evict(unsigned int handle) {
+    unload(handle);
+}
+
+const Mesh* LazyGeometry::mesh(unsigned int handle) const {
+    const auto& entry = *m_entries[handle];
+    return entry.resident ? &entry.mesh : nullptr;
+}
+
+bool LazyGeometry::blended(unsigned int handle) const {
+    return m_entries[handle]->blended;
+}
+
+void LazyGeometry::update() {
+    m_stats.loads = 0;
+    m_stats.resident = 0;
+
+    auto& cache = MeshCache::shared();
+    size_t uploaded = 0;
+    unsigned int inFlight = 0;
+
+    // finished decodes go to the GPU
+    for (auto handle = 0u; handle < m_entries.size(); handle++) {
+        if (!m_entries[handle] || !m_entries[handle]->pending.valid())
+            continue;
+        auto& entry = *m_entries[handle];
+        if (uploaded >= maxUploadBytesPerFrame || entry.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            inFlight++;
+            continue;
+        }
+
+        auto decoded = entry.pending.get();
+        if (!decoded.ok) {
+            entry.failed = true;
+            continue;
+        }
+        // another file may have the same part uploaded already
+        if (auto shared = cache.acquire(decoded.hash)) {
+            entry.mesh = *shared;
+        } else {
+            const auto& part = decoded.part;
+            uploaded += part.positions.size() * 4 + part.normals.size() * 4 + part.texcoords.size() * 4 + part.colors.size() +
+                        part.indices.size() * 2;
+            entry.mesh = cache.insert(decoded.hash, MeshCache::upload(part));
+        }
+        entry.blended = decoded.part.blended;
+        entry.resident = true;
+        m_residency.add(Residency::Kind::Mesh, handle, MeshCache::bytes(entry.mesh));
+        m_stats.loads++;
+        m_generation++;
+    }
+
+    // what's in view is decoded first, parts close to it get the slots that are left
+    for (auto pass : {Request::Visible, Request::Prefetch}) {
+        for (auto& slot : m_entries) {
+            if (!slot || slot->requested != pass)
+                continue;
+            auto& entry = *slot;
+            if (entry.resident || entry.pending.valid() || entry.failed || inFlight >= maxDecodesInFlight)
+                continue;
+
+            entry.pending = ThreadPool::shared().submit([filename = entry.filename, geometry = entry.geometry]() {
+                Decoded decoded;
+                decoded.part.geometry = geometry;
+                try {
+                    BinReader reader(filename, Endianness::Big);
+                    SceneParser::decodeGeometry(reader, decoded.part);
+                } catch (const ReadError& e) {
+                    logW("MESH: Couldn't decode a part of {} at 0x{:08X}: {}", filename, e.offset(), e.what());
+                    return decoded;
+                }
+                const auto& part = decoded.part;
+                decoded.hash = MeshCache::hash(part.positions.data(), part.normals.data(), part.texcoords.data(),
+                                               part.colors.data(), part.positions.size() / 3, part.indices.data(),
+                                               part.indices.size());
+                decoded.ok = true;
+                return decoded;
+            });
+            inFlight++;
+        }
+    }
+
+    for (auto& slot : m_entries) {
+        if (!slot)
+            continue;
+        slot->requested = Request::None;
+        if (slot->resident)
+            m_stats.resident++;
+    }
+    m_stats.decoding = inFlight;
+}
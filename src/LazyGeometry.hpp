@@ -0,0 +1,79 @@
+#pragma once
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include <raylib.h>
+#include "Residency.hpp"
+#include "SceneData.hpp"
+
+struct LazyGeometryStats {
+    unsigned int parts = 0;
+    unsigned int resident = 0;
+    unsigned int decoding = 0;
+    unsigned int loads = 0; // this frame
+};
+
+// Geometry of parts parsed with ParseOptions::deferGeometry, decoded from the offsets the parser recorded
+// and uploaded only once a part is visible or close to it. Decodes run on the thread pool, uploads go
+// through MeshCache so a part identical to one already uploaded shares its mesh. Until then the part
+// has no mesh and isn't drawn. Uploads are reported to `residency`, which may pick them for eviction
+class LazyGeometry {
+  public:
+    explicit LazyGeometry(Residency& residency);
+    ~LazyGeometry();
+
+    // `part` must be deferred, returns the handle the part refers to its geometry by
+    unsigned int add(const std::string& filename, const ScenePart& part);
+    void remove(unsigned int handle);
+    void reset();
+    bool empty() const { return m_count == 0; }
+
+    // the part is in view this frame, or only close to it (`prefetch`), which is decoded after what's in view
+    void request(unsigned int handle, bool prefetch);
+    // unloads the mesh now, it's read from the file again once requested
+    void evict(unsigned int handle);
+    // uploads finished decodes and starts decodes for the requested parts
+    void update();
+    // null while the part isn't resident
+    const Mesh* mesh(unsigned int handle) const;
+    // some vertex alpha is below 255, only known once resident
+    bool blended(unsigned int handle) const;
+
+    // changes whenever a part becomes resident or is evicted
+    unsigned long generation() const { return m_generation; }
+    const LazyGeometryStats& stats() const { return m_stats; }
+
+  private:
+    struct Decoded {
+        ScenePart part;
+        uint64_t hash = 0;
+        bool ok = false;
+    };
+
+    enum class Request {
+        None,
+        Prefetch,
+        Visible
+    };
+
+    struct Entry {
+        std::string filename;
+        GeometryRef geometry;
+        Mesh mesh; // holds a MeshCache reference while resident
+        bool resident;
+        bool blended;
+        bool failed; // couldn't be decoded, never drawn
+        Request requested;
+        std::future<Decoded> pending;
+    };
+
+    void unload(unsigned int handle);
+
+    Residency& m_residency;
+    std::vector<std::unique_ptr<Entry>> m_entries; // by handle, null for free slots
+    std::vector<unsigned int> m_free;
+    unsigned int m_count;
+    unsigned long m_generation;
+    LazyGeometryStats m_stats;
+};
@@ -0,0 +1,169 @@
+#include "LazyTextures.hpp"
+
+#include <rlgl.h>
+#include "TextureCache.hpp"
+#include "Textures.hpp"
+#include "ThreadPool.hpp"
+#include "logger.hpp"
+
+// like TextureStreamer, keeps a single frame from stalling on uploads
+constexpr size_t maxUploadBytesPerFrame = 8 * 1024 * 1024;
+constexpr unsigned int maxDecodesInFlight = 8;
+
+LazyTextures::LazyTextures(Residency& residency) : m_residency(residency), m_generation(0) {}
+
+LazyTextures::~LazyTextures() {
+    reset();
+}
+
+unsigned int LazyTextures::add(TextureBlob&& blob) {
+    if (auto it = m_byHash.find(blob.hash); it != m_byHash.end()) {
+        m_entries[it->second]->refs++;
+        return it->second;
+    }
+
+    auto entry = std::make_unique<Entry>();
+    entry->blob = std::move(blob);
+    entry->refs = 1;
+    entry->texture = {};
+    entry->lastVisible = 0;
+    entry->requested = false;
+    entry->failed = false;
+
+    unsigned int handle;
+    if (!m_free.empty()) {
+        handle = m_free.back();
+        m_free.pop_back();
+        m_entries[handle] = std::move(entry);
+    } else {
+        handle = m_entries.size();
+        m_entries.push_back(std::move(entry));
+    }
+    m_byHash[m_entries[handle]->blob.hash] = handle;
+    m_stats.textures = m_byHash.size();
+    return handle;
+}
+
+void LazyTextures::remove(unsigned int handle) {
+    auto& entry = m_entries[handle];
+    if (--entry->refs > 0)
+        return;
+
+    // the decode reads the blob
+    if (entry->pending.valid())
+        UnloadImage(entry->pending.get());
+    unload(handle);
+    m_residency.forget(Residency::Kind::Texture, handle);
+    m_byHash.erase(entry->blob.hash);
+    entry.reset();
+    m_free.push_back(handle);
+    m_stats.textures = m_byHash.size();
+}
+
+void LazyTextures::reset() {
+    for (auto handle = 0u; handle < m_entries.size(); handle++) {
+        auto& entry = m_entries[handle];
+        if (!entry)
+            continue;
+        if (entry->pending.valid())
+            UnloadImage(entry->pending.get());
+        unload(handle);
+        m_residency.forget(Residency::Kind::Texture, handle);
+    }
+    m_entries.clear();
+    m_free.clear();
+    m_byHash.clear();
+    m_stats = {};
+}
+
+void LazyTextures::unload(unsigned int handle) {
+    auto& entry = *m_entries[handle];
+    if (entry.texture.id == 0)
+        return;
+    if (!TextureCache::shared().release(entry.texture.id))
+        UnloadTexture(entry.texture);
+    entry.texture = {};
+    m_residency.remove(Residency::Kind::Texture, handle);
+    m_generation++;
+}
+
+void LazyTextures::request(unsigned int handle) {
+    m_entries[handle]->requested = true;
+    m_residency.touch(Residency::Kind::Texture, handle);
+}
+
+void LazyTextures::evict(unsigned int handle) {
+    unload(handle);
+}
+
+Texture LazyTextures::texture(unsigned int handle) const {
+    const auto& entry = *m_entries[handle];
+    if (entry.texture.id != 0)
+        return entry.texture;
+    return {rlGetTextureIdDefault(), 1, 1, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+}
+
+void LazyTextures::update(double now, double evictAfter) {
+    m_stats.loads = 0;
+    m_stats.evictions = 0;
+    m_stats.decoding = 0;
+    m_stats.resident = 0;
+
+    auto& cache = TextureCache::shared();
+    size_t uploaded = 0;
+    unsigned int inFlight = 0;
+
+    // finished decodes go to the GPU, the rest count towards the decodes in flight before any new one starts
+    for (auto handle = 0u; handle < m_entries.size(); handle++) {
+        if (!m_entries[handle] || !m_entries[handle]->pending.valid())
+            continue;
+        auto& entry = *m_entries[handle];
+        if (uploaded >= maxUploadBytesPerFrame || entry.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            inFlight++;
+            continue;
+        }
+
+        auto img = entry.pending.get();
+        if (img.data) {
+            uploaded += GetPixelDataSize(img.width, img.height, img.format);
+            entry.texture = cache.insert(entry.blob.hash, textures::upload(img));
+            m_residency.add(Residency::Kind::Texture, handle, textures::getTextureSize(entry.texture));
+            m_stats.loads++;
+            m_generation++;
+        } else {
+            logW("TEXTURES: Couldn't decode texture {:016X}, keeping its placeholder", entry.blob.hash);
+            entry.failed = true;
+        }
+        UnloadImage(img);
+    }
+
+    for (auto handle = 0u; handle < m_entries.size(); handle++) {
+        if (!m_entries[handle])
+            continue;
+        auto& entry = *m_entries[handle];
+
+        if (entry.requested) {
+            entry.requested = false;
+            entry.lastVisible = now;
+            if (entry.texture.id == 0 && !entry.pending.valid() && !entry.failed) {
+                // another file may have it uploaded already
+                if (auto tex = cache.acquire(entry.blob.hash)) {
+                    entry.texture = *tex;
+                    m_residency.add(Residency::Kind::Texture, handle, textures::getTextureSize(entry.texture));
+                    m_stats.loads++;
+                    m_generation++;
+                } else if (inFlight < maxDecodesInFlight) {
+                    entry.pending = ThreadPool::shared().submit([blob = &entry.blob]() { return textures::decode(*blob); });
+                    inFlight++;
+                }
+            }
+        } else if (entry.texture.id != 0 && now - entry.lastVisible > evictAfter) {
+            unload(handle);
+            m_stats.evictions++;
+        }
+
+        if (entry.texture.id != 0)
+            m_stats.resident++;
+    }
+    m_stats.decoding = inFlight;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <future>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <raylib.h>
+#include "Residency.hpp"
+#include "SceneData.hpp"
+
+struct LazyTextureStats {
+    unsigned int textures = 0;
+    unsigned int resident = 0;
+    unsigned int decoding = 0;
+    unsigned int loads = 0;     // this frame
+    unsigned int evictions = 0; // this frame
+};
+
+// Textures that are decoded and uploaded only once a visible part uses them, and unloaded again after a
+// while out of view. The blobs stay in memory, compressed as the file stores them, so bringing a texture
+// back is a decode on the thread pool and an upload. Until then parts get the default white texture,
+// which leaves them showing their vertex colors. Blobs with the same hash share one entry. Uploads are
+// reported to `residency`, which may pick them for eviction
+class LazyTextures {
+  public:
+    explicit LazyTextures(Residency& residency);
+    ~LazyTextures();
+
+    // returns the handle parts refer to the texture by
+    unsigned int add(TextureBlob&& blob);
+    void remove(unsigned int handle);
+    void reset();
+    bool empty() const { return m_byHash.empty(); }
+
+    // a part using `handle` is visible this frame
+    void request(unsigned int handle);
+    // unloads the texture now, it's decoded again once requested
+    void evict(unsigned int handle);
+    // uploads finished decodes, starts decodes for requested textures and unloads the ones not requested
+    // for `evictAfter` seconds
+    void update(double now, double evictAfter);
+    // what to bind for `handle` right now, the placeholder until it's resident
+    Texture texture(unsigned int handle) const;
+
+    // changes whenever a texture becomes resident or is evicted
+    unsigned long generation() const { return m_generation; }
+    const LazyTextureStats& stats() const { return m_stats; }
+
+  private:
+    struct Entry {
+        TextureBlob blob;
+        unsigned int refs;
+        Texture texture; // id 0 while not resident
+        double lastVisible;
+        bool requested;
+        bool failed; // couldn't be decoded, stays a placeholder
+        std::future<Image> pending;
+    };
+
+    void unload(unsigned int handle);
+
+    Residency& m_residency;
+    std::vector<std::unique_ptr<Entry>> m_entries; // by handle, null for free slots
+    std::vector<unsigned int> m_free;
+    std::unordered_map<uint64_t, unsigned int> m_byHash;
+    unsigned long m_generation;
+    LazyTextureStats m_stats;
+};
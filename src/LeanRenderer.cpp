@@ -0,0 +1,44 @@
+#include "LeanRenderer.hpp"
+
+#include <raymath.h>
+#include <rlgl.h>
+
+LeanRenderer::LeanRenderer() : m_locs(nullptr), m_boundTexture(0), m_draws(0) {}
+
+void LeanRenderer::begin() {
+    m_locs = rlGetShaderLocsDefault();
+    m_boundTexture = 0;
+    m_draws = 0;
+
+    rlEnableShader(rlGetShaderIdDefault());
+
+    // same values DrawModel(model, {0, 0, 0}, 1.f, WHITE) ends up with: identity model transform, white diffuse
+    if (m_locs[SHADER_LOC_COLOR_DIFFUSE] != -1) {
+        float diffuse[4] = {1.f, 1.f, 1.f, 1.f};
+        rlSetUniform(m_locs[SHADER_LOC_COLOR_DIFFUSE], diffuse, RL_SHADER_UNIFORM_VEC4, 1);
+    }
+    auto matModelView = MatrixMultiply(MatrixMultiply(MatrixIdentity(), rlGetMatrixTransform()), rlGetMatrixModelview());
+    rlSetUniformMatrix(m_locs[SHADER_LOC_MATRIX_MVP], MatrixMultiply(matModelView, rlGetMatrixProjection()));
+
+    int slot = 0;
+    rlSetUniform(m_locs[SHADER_LOC_MAP_DIFFUSE], &slot, RL_SHADER_UNIFORM_INT, 1);
+    rlActiveTextureSlot(0);
+}
+
+void LeanRenderer::draw(const Mesh& mesh, const Material& material, int triangleCount) {
+    auto texture = material.maps[MATERIAL_MAP_DIFFUSE].texture.id;
+    if (texture != m_boundTexture) {
+        rlEnableTexture(texture);
+        m_boundTexture = texture;
+    }
+
+    rlEnableVertexArray(mesh.vaoId);
+    rlDrawVertexArrayElements(0, triangleCount * 3, 0);
+    m_draws++;
+}
+
+void LeanRenderer::end() {
+    rlDisableVertexArray();
+    rlDisableTexture();
+    rlDisableShader();
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <raylib.h>
+
+// Draws parts straight through rlgl instead of DrawModel. Every part is drawn at the origin
+// with the default material, so the shader, the MVP and the diffuse color only have to be set
+// once per frame; between draws only the VAO and (when it changes) the diffuse texture are bound.
+// The uniforms are computed exactly like DrawMesh does, so the output is identical.
+class LeanRenderer {
+  public:
+    LeanRenderer();
+
+    void begin();
+    void draw(const Mesh& mesh, const Material& material, int triangleCount);
+    void end();
+
+    unsigned int frameDraws() const { return m_draws; }
+
+  private:
+    int* m_locs;
+    unsigned int m_boundTexture;
+    unsigned int m_draws;
+};
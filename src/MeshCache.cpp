@@ -0,0 +1,92 @@
+#include "MeshCache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include "Hash.hpp"
+#include "Trace.hpp"
+
+MeshCache& MeshCache::shared() {
+    static MeshCache cache;
+    return cache;
+}
+
+uint64_t MeshCache::hash(const float* vertices, const float* normals, const float* texcoords, const uint8_t* colors,
+                         int vertexCount, const uint16_t* indices, int indexCount) {
+    auto h = hash::xxh64(vertices, vertexCount * sizeof(float) * 3);
+    h = hash::xxh64(normals, vertexCount * sizeof(float) * 3, h);
+    h = hash::xxh64(texcoords, vertexCount * sizeof(float) * 2, h);
+    h = hash::xxh64(colors, vertexCount * 4, h);
+    return hash::xxh64(indices, indexCount * sizeof(uint16_t), h);
+}
+
+Mesh MeshCache::upload(const ScenePart& part) {
+    Mesh mesh = {0};
+
+    mesh.vertexCount = part.positions.size() / 3;
+    mesh.triangleCount = part.indices.size() / 3;
+
+    // raylib owns (and frees) the arrays of a mesh
+    auto copy = [](const auto& stream) {
+        auto size = stream.size() * sizeof(stream[0]);
+        auto ptr = MemAlloc(std::max(size, (size_t)1));
+        std::memcpy(ptr, stream.data(), size);
+        return ptr;
+    };
+    mesh.vertices = (float*)copy(part.positions);
+    mesh.normals = (float*)copy(part.normals);
+    mesh.texcoords = (float*)copy(part.texcoords);
+    mesh.colors = (uint8_t*)copy(part.colors);
+    mesh.indices = (unsigned short*)copy(part.indices);
+
+    NUEX_TRACE_SCOPE("uploadMesh");
+    NUEX_TRACE_BYTES(part.positions.size() * 4 + part.normals.size() * 4 + part.texcoords.size() * 4 + part.colors.size() +
+                     part.indices.size() * 2);
+    UploadMesh(&mesh, false);
+    return mesh;
+}
+
+size_t MeshCache::bytes(const Mesh& mesh) {
+    // positions, normals, texcoords and colors, then 16 bit indices
+    return (size_t)mesh.vertexCount * (12 + 12 + 8 + 4) + (size_t)mesh.triangleCount * 3 * 2;
+}
+
+std::optional<Mesh> MeshCache::acquire(uint64_t hash) {
+    std::lock_guard lock(m_mutex);
+    auto it = m_entries.find(hash);
+    if (it == m_entries.end())
+        return std::nullopt;
+    it->second.refs++;
+    return it->second.mesh;
+}
+
+Mesh MeshCache::insert(uint64_t hash, const Mesh& mesh) {
+    std::lock_guard lock(m_mutex);
+    auto [it, inserted] = m_entries.try_emplace(hash, Entry {mesh, 1});
+    if (!inserted) {
+        UnloadMesh(mesh);
+        it->second.refs++;
+        return it->second.mesh;
+    }
+    m_hashes[mesh.vboId[0]] = hash;
+    return mesh;
+}
+
+bool MeshCache::release(const Mesh& mesh) {
+    std::lock_guard lock(m_mutex);
+    auto hashIt = m_hashes.find(mesh.vboId[0]);
+    if (hashIt == m_hashes.end())
+        return false;
+
+    auto it = m_entries.find(hashIt->second);
+    if (--it->second.refs == 0) {
+        UnloadMesh(it->second.mesh);
+        m_entries.erase(it);
+        m_hashes.erase(hashIt);
+    }
+    return true;
+}
+
+size_t MeshCache::size() {
+    std::lock_guard lock(m_mutex);
+    return m_entries.size();
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <raylib.h>
+#include "SceneData.hpp"
+
+// Process-wide cache of uploaded meshes keyed by the hash of their streams, so a part that shows up in
+// several loaded files (a character in its .ghg and in the level) is uploaded once. Refcounted like
+// TextureCache, the mesh is unloaded when the last part using it is released
+class MeshCache {
+  public:
+    static MeshCache& shared();
+
+    // xxh64 over every stream of the mesh
+    static uint64_t hash(const float* vertices, const float* normals, const float* texcoords, const uint8_t* colors,
+                         int vertexCount, const uint16_t* indices, int indexCount);
+    // copies a part's streams into a raylib mesh (which owns its arrays) and uploads it, the result isn't cached yet
+    static Mesh upload(const ScenePart& part);
+    // VRAM an uploaded mesh takes, counting the streams upload() fills
+    static size_t bytes(const Mesh& mesh);
+
+    // adds a reference if the mesh is cached
+    std::optional<Mesh> acquire(uint64_t hash);
+    // takes ownership of the uploaded `mesh` with one reference. If the hash got cached meanwhile, `mesh`
+    // is unloaded and the cached mesh is returned instead
+    Mesh insert(uint64_t hash, const Mesh& mesh);
+    // returns false if the mesh isn't owned by the cache
+    bool release(const Mesh& mesh);
+
+    size_t size();
+
+  private:
+    struct Entry {
+        Mesh mesh;
+        unsigned int refs;
+    };
+
+    std::unordered_map<uint64_t, Entry> m_entries;
+    std::unordered_map<unsigned int, uint64_t> m_hashes; // vertex VBO -> hash, the VAO id is 0 without VAO support
+    std::mutex m_mutex;
+};
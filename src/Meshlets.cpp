@@ -0,0 +1,148 @@
+#include "Meshlets.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <raymath.h>
+
+namespace meshlets {
+    static Vector3 getPosition(const float* positions, unsigned short idx) {
+        return {positions[idx * 3 + 0], positions[idx * 3 + 1], positions[idx * 3 + 2]};
+    }
+
+    static void computeBounds(Meshlet& meshlet, const std::vector<unsigned short>& verts, const float* positions,
+                              const std::vector<unsigned short>& indices) {
+        auto min = getPosition(positions, verts[0]);
+        auto max = min;
+        for (auto v : verts) {
+            auto pos = getPosition(positions, v);
+            min = Vector3Min(min, pos);
+            max = Vector3Max(max, pos);
+        }
+        meshlet.center = Vector3Scale(Vector3Add(min, max), 0.5f);
+        meshlet.radius = 0.f;
+        for (auto v : verts) {
+            meshlet.radius = std::max(meshlet.radius, Vector3Distance(meshlet.center, getPosition(positions, v)));
+        }
+
+        std::vector<Vector3> normals;
+        normals.reserve(meshlet.triangleCount);
+        auto axis = Vector3 {0, 0, 0};
+        for (auto i = 0u; i < meshlet.triangleCount; i++) {
+            auto base = meshlet.indexOffset + i * 3;
+            auto a = getPosition(positions, indices[base + 0]);
+            auto b = getPosition(positions, indices[base + 1]);
+            auto c = getPosition(positions, indices[base + 2]);
+            auto normal = Vector3CrossProduct(Vector3Subtract(b, a), Vector3Subtract(c, a));
+            if (Vector3Length(normal) == 0.f)
+                continue; // degenerate
+            normal = Vector3Normalize(normal);
+            normals.push_back(normal);
+            axis = Vector3Add(axis, normal);
+        }
+
+        // same rule as meshoptimizer: cones wider than ~84 degrees can't be culled
+        meshlet.coneAxis = {0, 0, 0};
+        meshlet.coneCutoff = 1.f;
+        if (normals.empty() || Vector3Length(axis) == 0.f)
+            return;
+
+        axis = Vector3Normalize(axis);
+        auto minDot = 1.f;
+        for (const auto& normal : normals) {
+            minDot = std::min(minDot, Vector3DotProduct(normal, axis));
+        }
+        if (minDot <= 0.1f)
+            return;
+
+        meshlet.coneAxis = axis;
+        meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+    }
+
+    void build(const float* positions, size_t vertexCount, const unsigned short* indices, size_t indexCount, MeshletPart& out) {
+        out.meshlets.clear();
+        out.indices.clear();
+        out.indices.reserve(indexCount);
+
+        // id of the meshlet that last referenced each vertex
+        std::vector<unsigned int> marker(vertexCount, std::numeric_limits<unsigned int>::max());
+        std::vector<unsigned short> verts;
+        verts.reserve(maxVertices);
+
+        unsigned int id = 0;
+        Meshlet current = {};
+
+        auto finish = [&]() {
+            if (current.triangleCount == 0)
+                return;
+            computeBounds(current, verts, positions, out.indices);
+            out.meshlets.push_back(current);
+            id++;
+            verts.clear();
+            current = {};
+            current.indexOffset = out.indices.size();
+        };
+
+        for (auto i = 0u; i + 2 < indexCount; i += 3) {
+            auto a = indices[i + 0];
+            auto b = indices[i + 1];
+            auto c = indices[i + 2];
+            if (a >= vertexCount || b >= vertexCount || c >= vertexCount)
+                continue;
+
+            auto newVerts = (marker[a] != id) + (marker[b] != id && b != a) + (marker[c] != id && c != a && c != b);
+            if (verts.size() + newVerts > maxVertices || current.triangleCount == maxTriangles)
+                finish();
+
+            for (auto v : {a, b, c}) {
+                if (marker[v] != id) {
+                    marker[v] = id;
+                    verts.push_back(v);
+                }
+            }
+            out.indices.push_back(a);
+            out.indices.push_back(b);
+            out.indices.push_back(c);
+            current.triangleCount++;
+        }
+        finish();
+
+        out.visible.assign(out.meshlets.size(), 1);
+        out.visibleIndices = out.indices;
+        out.changed = true; // the GPU still has the original triangle order
+        out.uploaded = false;
+    }
+
+    size_t cull(MeshletPart& part, const Frustum& frustum, Vector3 camPos) {
+        size_t count = 0;
+        bool changed = false;
+
+        for (auto i = 0u; i < part.meshlets.size(); i++) {
+            const auto& meshlet = part.meshlets[i];
+            bool visible = frustum.containsSphere(meshlet.center, meshlet.radius);
+            if (visible && meshlet.coneCutoff < 1.f) {
+                auto dir = Vector3Subtract(meshlet.center, camPos);
+                visible = Vector3DotProduct(dir, meshlet.coneAxis) < meshlet.coneCutoff * Vector3Length(dir) + meshlet.radius;
+            }
+            if ((uint8_t)visible != part.visible[i]) {
+                part.visible[i] = visible;
+                changed = true;
+            }
+            count += visible;
+        }
+
+        if (changed) {
+            part.visibleIndices.clear();
+            for (auto i = 0u; i < part.meshlets.size(); i++) {
+                if (!part.visible[i])
+                    continue;
+                const auto& meshlet = part.meshlets[i];
+                auto begin = part.indices.begin() + meshlet.indexOffset;
+                part.visibleIndices.insert(part.visibleIndices.end(), begin, begin + meshlet.triangleCount * 3);
+            }
+            part.changed = true;
+        }
+
+        return count;
+    }
+} // namespace meshlets
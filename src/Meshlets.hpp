@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <raylib.h>
+#include "Frustum.hpp"
+
+struct Meshlet {
+    Vector3 center;
+    float radius;
+    Vector3 coneAxis;
+    float coneCutoff; // 1 means the cone is too wide to ever be backfacing
+    unsigned int indexOffset;
+    unsigned int triangleCount;
+};
+
+struct MeshletPart {
+    std::vector<Meshlet> meshlets;
+    std::vector<unsigned short> indices;        // the part's triangles, regrouped meshlet by meshlet
+    std::vector<unsigned short> visibleIndices; // survivors of the last cull, compacted
+    std::vector<uint8_t> visible;               // per meshlet, from the last cull
+    bool changed;                               // visibleIndices differ from what the GPU has
+    bool uploaded;                              // the GPU index buffer holds visibleIndices instead of the original ones
+};
+
+namespace meshlets {
+    constexpr size_t maxVertices = 64;
+    constexpr size_t maxTriangles = 124;
+
+    void build(const float* positions, size_t vertexCount, const unsigned short* indices, size_t indexCount, MeshletPart& out);
+    // returns the number of meshlets that survived
+    size_t cull(MeshletPart& part, const Frustum& frustum, Vector3 camPos);
+} // namespace meshlets
@@ -0,0 +1,148 @@
+#include "OcclusionCuller.hpp"
+
+#include <raymath.h>
+#include "gl.hpp"
+#include "logger.hpp"
+
+static const char* boxVS = R"(#version 330
+in vec3 vertexPosition;
+uniform mat4 mvp;
+uniform vec3 boxMin;
+uniform vec3 boxMax;
+void main() {
+    gl_Position = mvp * vec4(mix(boxMin, boxMax, vertexPosition), 1.0);
+}
+)";
+
+static const char* boxFS = R"(#version 330
+out vec4 finalColor;
+void main() {
+    finalColor = vec4(1.0);
+}
+)";
+
+// unit cube, 12 triangles
+static const float cubeVertices[] = {
+    0, 0, 1, 1, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 1, 1, // +z
+    1, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 1, 0, 1, 1, 0, // -z
+    0, 0, 0, 0, 0, 1, 0, 1, 1, 0, 0, 0, 0, 1, 1, 0, 1, 0, // -x
+    1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 1, 1, 1, 0, 1, 1, 1, // +x
+    0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, // +y
+    0, 0, 0, 1, 0, 0, 1, 0, 1, 0, 0, 0, 1, 0, 1, 0, 0, 1, // -y
+};
+
+OcclusionCuller::OcclusionCuller() : m_shader(0), m_mvpLoc(-1), m_minLoc(-1), m_maxLoc(-1), m_vao(0), m_vbo(0), m_queried(0) {}
+
+OcclusionCuller::~OcclusionCuller() {
+    reset();
+    if (m_shader != 0) {
+        rlUnloadShaderProgram(m_shader);
+        rlUnloadVertexBuffer(m_vbo);
+        rlUnloadVertexArray(m_vao);
+    }
+}
+
+void OcclusionCuller::loadResources() {
+    m_shader = rlLoadShaderCode(boxVS, boxFS);
+    m_mvpLoc = rlGetLocationUniform(m_shader, "mvp");
+    m_minLoc = rlGetLocationUniform(m_shader, "boxMin");
+    m_maxLoc = rlGetLocationUniform(m_shader, "boxMax");
+
+    m_vao = rlLoadVertexArray();
+    rlEnableVertexArray(m_vao);
+    m_vbo = rlLoadVertexBuffer(cubeVertices, sizeof(cubeVertices), false);
+    rlSetVertexAttribute(rlGetLocationAttrib(m_shader, "vertexPosition"), 3, RL_FLOAT, false, 0, 0);
+    rlEnableVertexAttribute(rlGetLocationAttrib(m_shader, "vertexPosition"));
+    rlDisableVertexArray();
+
+    logD("OCCLUSION: Resources loaded (shader {})", m_shader);
+}
+
+void OcclusionCuller::resize(size_t count) {
+    reset();
+
+    m_queries.resize(count);
+    if (count == 0)
+        return;
+
+    std::vector<GLuint> ids(count);
+    glGenQueries(count, ids.data());
+    for (auto i = 0u; i < count; i++) {
+        // everything starts visible so the first frame fills the depth buffer
+        m_queries[i] = {ids[i], false, true};
+    }
+}
+
+void OcclusionCuller::reset() {
+    for (const auto& query : m_queries) {
+        glDeleteQueries(1, &query.id);
+    }
+    m_queries.clear();
+}
+
+bool OcclusionCuller::isVisible(size_t idx, const BoundingBox& box, Vector3 camPos) {
+    auto& query = m_queries[idx];
+
+    if (query.pending) {
+        GLuint available = 0;
+        glGetQueryObjectuiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint samples = 0;
+            glGetQueryObjectuiv(query.id, GL_QUERY_RESULT, &samples);
+            query.visible = samples != 0;
+            query.pending = false;
+        }
+    }
+
+    // the box gets clipped by the near plane when we're inside it, so the query can't be trusted
+    constexpr float margin = 0.1f;
+    if (camPos.x >= box.min.x - margin && camPos.x <= box.max.x + margin && camPos.y >= box.min.y - margin &&
+        camPos.y <= box.max.y + margin && camPos.z >= box.min.z - margin && camPos.z <= box.max.z + margin) {
+        query.visible = true;
+    }
+
+    return query.visible;
+}
+
+void OcclusionCuller::issueQueries(const std::vector<BoundingBox>& boxes) {
+    if (m_shader == 0)
+        loadResources();
+
+    m_queried = 0;
+
+    rlDrawRenderBatchActive();
+
+    auto mvp = MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection());
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    rlDisableDepthMask();
+    rlDisableBackfaceCulling();
+
+    rlEnableShader(m_shader);
+    rlSetUniformMatrix(m_mvpLoc, mvp);
+    rlEnableVertexArray(m_vao);
+
+    for (auto i = 0u; i < m_queries.size(); i++) {
+        auto& query = m_queries[i];
+        if (query.pending)
+            continue;
+
+        const auto& box = boxes[i];
+        rlSetUniform(m_minLoc, &box.min, RL_SHADER_UNIFORM_VEC3, 1);
+        rlSetUniform(m_maxLoc, &box.max, RL_SHADER_UNIFORM_VEC3, 1);
+
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, query.id);
+        rlDrawVertexArray(0, 36);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+
+        query.pending = true;
+        m_queried++;
+    }
+
+    rlDisableVertexArray();
+    rlDisableShader();
+
+    rlEnableBackfaceCulling();
+    rlEnableDepthMask();
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <raylib.h>
+
+// Hardware occlusion culling with temporal coherence: every part gets its own GL query,
+// and the result of the query issued in an earlier frame decides whether the part is drawn
+// now. Results are only read once they are available, so the CPU never waits on the GPU.
+class OcclusionCuller {
+  public:
+    OcclusionCuller();
+    ~OcclusionCuller();
+
+    void resize(size_t count);
+    void reset();
+
+    // returns the latest known visibility of the part, picking up finished queries along the way
+    bool isVisible(size_t idx, const BoundingBox& box, Vector3 camPos);
+    // issues queries for every part that doesn't have one in flight. Call after drawing the visible parts
+    void issueQueries(const std::vector<BoundingBox>& boxes);
+
+    size_t size() const { return m_queries.size(); }
+    unsigned int lastQueried() const { return m_queried; }
+
+  private:
+    struct PartQuery {
+        unsigned int id;
+        bool pending;
+        bool visible;
+    };
+
+    void loadResources();
+
+    std::vector<PartQuery> m_queries;
+    unsigned int m_shader;
+    int m_mvpLoc;
+    int m_minLoc;
+    int m_maxLoc;
+    unsigned int m_vao;
+    unsigned int m_vbo;
+    unsigned int m_queried;
+};
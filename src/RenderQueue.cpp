@@ -0,0 +1,54 @@
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+#include <bit>
+
+uint64_t RenderQueue::makeKey(Pass pass, unsigned int texture, float depth, unsigned int item) {
+    // positive floats keep their order when compared as integers, the top 24 bits
+    // below the sign (8 exponent bits + the top 16 of the mantissa) give a logarithmic depth bucket for free
+    auto depthBits = (uint64_t)(std::bit_cast<uint32_t>(std::max(depth, 0.f)) >> 7) & 0xFFFFFF;
+    auto tex = (uint64_t)(texture & 0xFFFF);
+
+    uint64_t key = (uint64_t)pass << 62;
+    if (pass == Pass::Opaque) {
+        key |= tex << 46 | depthBits << itemBits;
+    } else {
+        key |= (~depthBits & 0xFFFFFF) << 38 | tex << itemBits;
+    }
+    return key | (item & (maxItems - 1));
+}
+
+void RenderQueue::reset(size_t count) {
+    m_keys.resize(count);
+}
+
+void RenderQueue::sort() {
+    auto count = m_keys.size();
+    m_scratch.resize(count);
+
+    // LSD radix sort, 8 bits per pass. Passes where every key has the same digit are skipped,
+    // which happens a lot for the upper texture bits and the pass bits
+    for (auto shift = 0u; shift < 64; shift += 8) {
+        size_t histogram[256] = {};
+        for (auto key : m_keys) {
+            histogram[(key >> shift) & 0xFF]++;
+        }
+        if (std::find(std::begin(histogram), std::end(histogram), count) != std::end(histogram))
+            continue;
+
+        size_t offset = 0;
+        for (auto& bucket : histogram) {
+            auto n = bucket;
+            bucket = offset;
+            offset += n;
+        }
+        for (auto key : m_keys) {
+            m_scratch[histogram[(key >> shift) & 0xFF]++] = key;
+        }
+        m_keys.swap(m_scratch);
+    }
+
+    while (!m_keys.empty() && m_keys.back() == culledKey) {
+        m_keys.pop_back();
+    }
+}
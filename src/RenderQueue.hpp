@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-frame list of draws packed into 64-bit sort keys, radix sorted so that
+// opaque parts are grouped by texture and drawn front-to-back, followed by
+// blended parts drawn back-to-front.
+//
+//   opaque:  | pass:2 | texture:16 | depth:24      | item:22 |
+//   blended: | pass:2 | ~depth:24  | texture:16    | item:22 |
+class RenderQueue {
+  public:
+    enum class Pass : uint64_t {
+        Opaque = 0,
+        Blended = 1
+    };
+
+    static constexpr unsigned int itemBits = 22;
+    static constexpr unsigned int maxItems = 1u << itemBits;
+    // sorts after every real key, used for items that got culled while building
+    static constexpr uint64_t culledKey = ~0ull;
+
+    static uint64_t makeKey(Pass pass, unsigned int texture, float depth, unsigned int item);
+    static unsigned int itemOf(uint64_t key) { return key & (maxItems - 1); }
+
+    // resizes the key list to `count` slots that can be filled from any thread
+    void reset(size_t count);
+    std::vector<uint64_t>& keys() { return m_keys; }
+    // sorts and drops the culled slots
+    void sort();
+
+    const std::vector<uint64_t>& sorted() const { return m_keys; }
+
+  private:
+    std::vector<uint64_t> m_keys;
+    std::vector<uint64_t> m_scratch;
+};
@@ -0,0 +1,92 @@
+#include "Residency.hpp"
+
+Residency::Residency() : m_bytes(0), m_pinned(0), m_frame(0) {}
+
+void Residency::add(Kind kind, unsigned int handle, size_t bytes) {
+    auto key = keyOf(kind, handle);
+    if (m_lookup.contains(key))
+        remove(kind, handle);
+    if (m_evicted.erase(key))
+        m_stats.reloads++;
+
+    m_lru.push_front({{kind, handle}, bytes, m_frame, false});
+    m_lookup[key] = m_lru.begin();
+    m_bytes += bytes;
+    updateStats();
+}
+
+void Residency::remove(Kind kind, unsigned int handle) {
+    auto it = m_lookup.find(keyOf(kind, handle));
+    if (it == m_lookup.end())
+        return;
+    if (!it->second->shared)
+        m_bytes -= it->second->bytes;
+    m_lru.erase(it->second);
+    m_lookup.erase(it);
+    updateStats();
+}
+
+void Residency::forget(Kind kind, unsigned int handle) {
+    remove(kind, handle);
+    m_evicted.erase(keyOf(kind, handle));
+}
+
+void Residency::reset() {
+    m_lru.clear();
+    m_lookup.clear();
+    m_evicted.clear();
+    m_bytes = 0;
+    m_pinned = 0;
+    m_stats = {};
+}
+
+void Residency::touch(Kind kind, unsigned int handle) {
+    auto it = m_lookup.find(keyOf(kind, handle));
+    if (it == m_lookup.end())
+        return;
+    it->second->lastVisible = m_frame;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+}
+
+void Residency::setShared(Kind kind, unsigned int handle, bool shared) {
+    auto it = m_lookup.find(keyOf(kind, handle));
+    if (it == m_lookup.end() || it->second->shared == shared)
+        return;
+    auto& entry = *it->second;
+    entry.shared = shared;
+    if (shared) {
+        m_bytes -= entry.bytes;
+    } else {
+        m_bytes += entry.bytes;
+    }
+    updateStats();
+}
+
+void Residency::setPinnedBytes(size_t bytes) {
+    m_pinned = bytes;
+    updateStats();
+}
+
+std::vector<Residency::Resource> Residency::evict(size_t budget) {
+    std::vector<Resource> victims;
+    auto total = residentBytes();
+    for (auto it = m_lru.rbegin(); it != m_lru.rend() && total > budget; it++) {
+        // the rest is at least as recent
+        if (it->lastVisible == m_frame)
+            break;
+        if (it->shared)
+            continue;
+        victims.push_back(it->resource);
+        m_evicted.insert(keyOf(it->resource.kind, it->resource.handle));
+        total -= it->bytes;
+    }
+    m_stats.evictions += victims.size();
+    m_frame++;
+    return victims;
+}
+
+void Residency::updateStats() {
+    m_stats.residentBytes = residentBytes();
+    m_stats.pinnedBytes = m_pinned;
+    m_stats.resident = m_lru.size();
+}
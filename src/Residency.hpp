@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct ResidencyStats {
+    size_t residentBytes = 0; // pinned included
+    size_t pinnedBytes = 0;
+    unsigned int resident = 0; // evictable resources on the GPU
+    unsigned int evictions = 0;
+    unsigned int reloads = 0; // evicted resources that were needed again
+};
+
+// VRAM bookkeeping for meshes and textures. Resources that can be brought back are kept in LRU order of
+// the frame they were last visible in: lazy textures, whose DDS blob stays in memory, and lazy geometry,
+// which is read again from its offsets in the file. Everything else only counts towards the total as
+// pinned. When the total is over the budget, the least recently visible ones are picked for eviction
+class Residency {
+  public:
+    enum class Kind {
+        Texture, // LazyTextures handle
+        Mesh     // LazyGeometry handle
+    };
+
+    struct Resource {
+        Kind kind;
+        unsigned int handle;
+    };
+
+    Residency();
+
+    // was uploaded, counts as visible this frame
+    void add(Kind kind, unsigned int handle, size_t bytes);
+    // was unloaded, evicted or not
+    void remove(Kind kind, unsigned int handle);
+    // the handle is gone and may be reused for something else
+    void forget(Kind kind, unsigned int handle);
+    void reset();
+
+    // is visible this frame
+    void touch(Kind kind, unsigned int handle);
+    // also held by something pinned, so evicting it frees nothing. Its bytes are left to the pinned ones and
+    // it's never picked. Cleared when the resource is uploaded again
+    void setShared(Kind kind, unsigned int handle, bool shared);
+    void setPinnedBytes(size_t bytes);
+
+    // ends the frame and returns what to evict to get back under `budget`, least recently visible first.
+    // Resources visible in the frame that just ended are never picked, so this can fall short
+    std::vector<Resource> evict(size_t budget);
+
+    size_t residentBytes() const { return m_bytes + m_pinned; }
+    const ResidencyStats& stats() const { return m_stats; }
+
+  private:
+    struct Entry {
+        Resource resource;
+        size_t bytes;
+        unsigned long lastVisible;
+        bool shared;
+    };
+
+    static uint64_t keyOf(Kind kind, unsigned int handle) { return (uint64_t)kind << 32 | handle; }
+    void updateStats();
+
+    std::list<Entry> m_lru; // most recently visible first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> m_lookup;
+    std::unordered_set<uint64_t> m_evicted; // picked by evict() and not uploaded again yet
+    size_t m_bytes; // of the evictable resources, shared ones excluded
+    size_t m_pinned;
+    unsigned long m_frame;
+    ResidencyStats m_stats;
+};
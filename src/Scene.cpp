@@ -1,671 +1,1039 @@
 #include "Scene.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <future>
 #include <sstream>
+#include <unordered_set>
+#include <rlgl.h>
 #include "logger.hpp"
-#include "BinReader.hpp"
-#include "utils.hpp"
-#include "umHalf.h"
-
-struct MeshAttrib {
-    MeshValType valType; // position, normal, etc
-    MeshVarType varType; // vec4half, vec2mini, etc
-};
-
-Scene::Scene() : m_refCounter(7) {}
+#include "MeshCache.hpp"
+#include "SceneParser.hpp"
+#include "TextureCache.hpp"
+#include "Textures.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+
+// slot of the index buffer in Mesh::vboId, see UploadMesh
+constexpr int meshIndexBuffer = 6;
+// below this the render queue keys are cheaper to build on the main thread
+constexpr size_t parallelQueueThreshold = 2048;
+// a changed file is reloaded once it's been left alone this long, exporters write in several goes
+constexpr std::chrono::milliseconds reloadSettle(300);
+// lazy geometry is prefetched for parts inside a frustum this much wider than the view
+constexpr float prefetchWidening = 1.5f;
+// and only while this much of the VRAM budget is left, so prefetching doesn't evict in turn
+constexpr float prefetchHeadroom = 0.9f;
+
+Scene::Scene()
+    : m_pinnedBytes(0), m_lazy(m_residency), m_lazyGeneration(0), m_geometry(m_residency), m_geometryGeneration(0),
+      m_indirectSupport(Support::Unknown) {}
 
 Scene::~Scene() {
-    cleanup();
+    clear();
 }
 
-void Scene::render() {
-    for (const auto& model : m_models) {
-        DrawModel(model, {0, 0, 0}, 1.f, WHITE);
+void Scene::render(const Camera& camera) {
+    m_stats = {};
+
+    updateResidency();
+    if (!m_streamer.empty())
+        streamTextures(camera);
+    if (!m_lazy.empty())
+        updateLazyTextures();
+    if (!m_geometry.empty())
+        updateGeometry();
+
+    if (m_settings.indirectDraw && renderIndirect())
+        return;
+
+    if (m_settings.meshletCulling) {
+        cullMeshlets(camera.position);
+    } else {
+        restoreIndices();
     }
-}
 
-void Scene::load(const std::string& filename) {
-    cleanup();
-    m_models.clear();
-    m_refCounter = 7;
-    m_vertexBuffers.clear();
-    m_indexBuffers.clear();
-    m_textures.clear();
-
-    logD("Loading a scene from {}", filename);
-
-    auto reader = BinReader(filename, Endianness::Big);
-
-    // load TXGH
-    auto txghOffset = reader.find(std::string_view("HGXT", 4));
-    if (txghOffset == 0) {
-        logE("TXGH: Couldn't find TXGH!");
-        exit(1);
-    }
-    logD("TXGH: Found at 0x{:08X}", txghOffset);
-    reader.seek(txghOffset);
-    reader.skip(4 + 4 + 4);
-    uint32_t texCount;
-    reader >> texCount;
-    logD("TXGH: {} textures", texCount);
-    reader.skip(texCount * 4 + 4);
-    reader >> texCount;
-    auto goodTexCount = texCount;
-    for (auto i = 0u; i < texCount; i++) {
-        reader.skip(16);
-        uint32_t nameLen;
-        reader >> nameLen;
-        if (nameLen > 0) {
-            char texName[nameLen];
-            reader.read((uint8_t*)texName, nameLen);
-            logD("TXGH:   * Texture {}: {}", i, (char*)texName);
-        } else {
-            logD("TXGH:   * Texture {}: <no name>", i);
-            goodTexCount--;
+    if (m_settings.occlusionCulling && m_occlusion.size() != m_models.size())
+        m_occlusion.resize(m_models.size());
+
+    auto visit = [&](unsigned int idx) {
+        if (m_settings.occlusionCulling && !m_occlusion.isVisible(idx, m_bounds[idx], camera.position)) {
+            m_stats.occluded++;
+            return;
+        }
+        drawPart(idx);
+    };
+
+    if (m_settings.sortedQueue)
+        buildQueue(camera.position);
+
+    auto drawStart = GetTime();
+    if (m_settings.leanDrawPath)
+        m_lean.begin();
+
+    if (m_settings.sortedQueue) {
+        for (auto key : m_queue.sorted()) {
+            visit(RenderQueue::itemOf(key));
+        }
+    } else {
+        for (auto i = 0u; i < m_models.size(); i++) {
+            visit(i);
         }
-        reader.skip(2 + 1 + 1);
     }
-    logD("TXGH: Good texture count: {} (of total {})", goodTexCount, texCount);
-    m_refCounter += goodTexCount; // i have 0 idea about how the heck this works but it does
-    reader.skip(4);
-    uint32_t unk;
-    reader >> unk;
-    m_refCounter += unk; // ¯\_(ツ)_/¯
 
-    // loading DISP
-    auto dispOffset = reader.find(std::string_view("PSID", 4));
-    if (dispOffset == 0) {
-        logE("DISP: Couldn't find DISP!");
-        exit(1);
+    if (m_settings.leanDrawPath)
+        m_lean.end();
+    updateDrawRate(GetTime() - drawStart, m_stats.drawn);
+
+    if (m_settings.occlusionCulling) {
+        // tested against this frame's depth, read back in a later one
+        m_occlusion.issueQueries(m_bounds);
+        m_stats.queried = m_occlusion.lastQueried();
     }
-    logD("DISP: Found at 0x{:08X}", dispOffset);
-    reader.seek(dispOffset);
-    reader.skip(4);
-    NUEX_ASSERT(reader.read<uint32_t>() == 15) // version should be 15 for now
-    reader.skip(reader.read<uint32_t>());      // skip filePath
-    reader.skip(4);                            // ROTV
+}
+
+void Scene::updateDrawRate(double seconds, unsigned int draws) {
+    m_drawRate.seconds += seconds;
+    m_drawRate.draws += draws;
 
-    std::vector<int> commandIndices;
-    auto commandsCount = reader.read<uint32_t>();
-    for (auto i = 0u; i < commandsCount; i++) {
-        auto cmd = reader.read<uint8_t>();
-        reader.skip(1);
-        auto index = reader.read<uint32_t>();
-        // if (cmd == 0xb3) {
-        //     logD("DISP: {} {:X} {}", i, cmd, index);
-        // }
-        commandIndices.push_back(index);
+    // averaged over about a second so the HUD stays readable
+    auto now = GetTime();
+    if (now - m_drawRate.windowStart >= 1.0) {
+        m_drawRate.perSecond = m_drawRate.seconds > 0 ? m_drawRate.draws / m_drawRate.seconds : 0;
+        m_drawRate = {now, 0, 0, m_drawRate.perSecond};
     }
+    m_stats.drawsPerSecond = m_drawRate.perSecond;
+}
 
-    logD("DISP: {} commandIndices count", commandIndices.size());
+void Scene::streamTextures(const Camera& camera) {
+    auto frustum = Frustum::fromMatrices(rlGetMatrixModelview(), rlGetMatrixProjection());
+    // pixels covered by one world unit at a distance of one unit
+    auto pixelsPerUnit = GetScreenHeight() / (2.f * std::tan(camera.fovy * DEG2RAD * 0.5f));
 
-    std::unordered_map<int, int> meshMaterials;
+    for (auto i = 0u; i < m_models.size(); i++) {
+        const auto& box = m_bounds[i];
+        if (!frustum.containsBox(box))
+            continue;
+
+        Vector3 center = {(box.min.x + box.max.x) * 0.5f, (box.min.y + box.max.y) * 0.5f, (box.min.z + box.max.z) * 0.5f};
+        Vector3 extent = {box.max.x - box.min.x, box.max.y - box.min.y, box.max.z - box.min.z};
+        Vector3 toCam = {center.x - camera.position.x, center.y - camera.position.y, center.z - camera.position.z};
+        auto diameter = std::sqrt(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z);
+        auto distance = std::max(std::sqrt(toCam.x * toCam.x + toCam.y * toCam.y + toCam.z * toCam.z) - diameter * 0.5f, 0.1f);
 
-    reader.skip(4);
-    auto clipObjectsSize = reader.read<uint32_t>();
-    logD("DISP: clipObjectsSize = {}", clipObjectsSize);
-    for (auto i = 0u; i < clipObjectsSize; i++) {
-        reader.skip(2);
+        m_streamer.request(m_models[i].materials[0].maps[MATERIAL_MAP_DIFFUSE].texture.id, diameter / distance * pixelsPerUnit);
+    }
 
-        std::vector<int> mtlIndices;
-        auto mtlIndicesSize = reader.read<uint32_t>();
-        for (auto j = 0u; j < mtlIndicesSize; j++) {
-            mtlIndices.push_back(reader.read<uint32_t>());
+    m_streamer.update((size_t)m_settings.textureBudgetMB * 1024 * 1024);
+    m_stats.streaming = m_streamer.stats();
+}
+
+void Scene::updateLazyTextures() {
+    auto frustum = Frustum::fromMatrices(rlGetMatrixModelview(), rlGetMatrixProjection());
+
+    std::vector<std::pair<size_t, unsigned int>> visible; // part, handle
+    for (const auto& file : m_files) {
+        if (file.lazyTextures.empty())
+            continue;
+        for (auto i = file.firstPart; i < file.firstPart + file.partCount; i++) {
+            auto it = file.lazyTextures.find(m_partTextures[i]);
+            if (it == file.lazyTextures.end() || !frustum.containsBox(m_bounds[i]))
+                continue;
+            m_lazy.request(it->second);
+            visible.emplace_back(i, it->second);
         }
+    }
 
-        // logD("mtlIndices.size = {}", mtlIndices.size());
+    m_lazy.update(GetTime(), m_settings.textureEvictSeconds);
+    for (auto [part, handle] : visible) {
+        m_models[part].materials[0].maps[MATERIAL_MAP_DIFFUSE].texture = m_lazy.texture(handle);
+    }
+    if (m_lazy.generation() != m_lazyGeneration) {
+        m_lazyGeneration = m_lazy.generation();
+        // evicted textures are unbound from parts out of view too, the paths without culling still draw them
+        for (const auto& file : m_files) {
+            if (file.lazyTextures.empty())
+                continue;
+            for (auto i = file.firstPart; i < file.firstPart + file.partCount; i++) {
+                if (auto it = file.lazyTextures.find(m_partTextures[i]); it != file.lazyTextures.end())
+                    m_models[i].materials[0].maps[MATERIAL_MAP_DIFFUSE].texture = m_lazy.texture(it->second);
+            }
+        }
+        // the indirect path batches by texture
+        m_indirect.reset();
+        markShared();
+    }
+    m_stats.lazy = m_lazy.stats();
+}
 
-        auto itemIndicesSize = reader.read<uint32_t>();
-        for (auto j = 0u; j < itemIndicesSize; j++) {
-            auto cmdIndex = reader.read<uint32_t>();
-            auto instanceIndex = commandIndices[cmdIndex];
-            // logD("i = {} j = {} index = {} instanceIndex = {} mtlIndex = {}", i, j, cmdIndex, instanceIndex, mtlIndices[j]);
-            meshMaterials[instanceIndex] = mtlIndices[j];
+void Scene::updateGeometry() {
+    auto view = rlGetMatrixModelview();
+    auto projection = rlGetMatrixProjection();
+    auto frustum = Frustum::fromMatrices(view, projection);
+    // a wider field of view, for what comes into view when the camera turns or moves a bit
+    projection.m0 /= prefetchWidening;
+    projection.m5 /= prefetchWidening;
+    auto nearby = Frustum::fromMatrices(view, projection);
+    auto prefetch = m_residency.residentBytes() < (size_t)m_settings.vramBudgetMB * 1024 * 1024 * prefetchHeadroom;
+
+    for (const auto& file : m_files) {
+        // the recorded offsets may not hold anymore until the new version is in
+        if (std::any_of(m_reloads.begin(), m_reloads.end(), [&](const auto& reload) { return reload.filename == file.filename; }))
+            continue;
+        for (auto i = file.firstPart; i < file.firstPart + file.partCount; i++) {
+            auto handle = m_partGeometry[i];
+            if (handle < 0)
+                continue;
+            if (frustum.containsBox(m_bounds[i])) {
+                m_geometry.request(handle, false);
+            } else if (prefetch && nearby.containsBox(m_bounds[i])) {
+                m_geometry.request(handle, true);
+            }
         }
     }
 
-    for (const auto [partIdx, mtlIdx] : meshMaterials) {
-        logD("DISP: Mesh part {}: material {}", partIdx, mtlIdx);
+    m_geometry.update();
+    if (m_geometry.generation() != m_geometryGeneration) {
+        m_geometryGeneration = m_geometry.generation();
+        for (auto i = 0u; i < m_models.size(); i++) {
+            if (m_partGeometry[i] >= 0)
+                bindGeometry(i);
+        }
+        // the indirect path copies every part's mesh into its pools
+        m_indirect.reset();
+        markShared();
     }
+    m_stats.geometry = m_geometry.stats();
+}
 
-    // loading UMTL
-    auto utmlOffset = reader.find(std::string_view("LTMU", 4));
-    if (utmlOffset == 0) {
-        logE("UMTL: Couldn't find UMTL!");
-        exit(1);
+void Scene::bindGeometry(size_t part) {
+    auto mesh = m_geometry.mesh(m_partGeometry[part]);
+    auto& model = m_models[part];
+    if (!mesh) {
+        // evicted, or not decoded yet
+        model.meshCount = 0;
+        if (part < m_meshlets.size())
+            m_meshlets[part] = {};
+        return;
     }
-    logD("UMTL: Found at 0x{:08X}", utmlOffset);
-    reader.seek(utmlOffset);
-    reader.skip(4);
-    uint32_t umtlVer, mtlCount;
-    reader >> umtlVer >> mtlCount >> mtlCount; // its intended
-    logD("UTML: Version 0x{:X}, {} materials", umtlVer, mtlCount);
-    NUEX_ASSERT(umtlVer == 0x94 || umtlVer == 0x95 || umtlVer == 0x96)
+    if (model.meshCount > 0 && model.meshes[0].vboId == mesh->vboId)
+        return;
 
-    std::vector<int> matTextureIDs;
+    model.meshes[0] = *mesh;
+    model.meshCount = 1;
+    m_blended[part] = m_geometry.blended(m_partGeometry[part]);
+    if (part < m_meshlets.size()) {
+        m_meshlets[part] = {};
+        meshlets::build(mesh->vertices, mesh->vertexCount, mesh->indices, mesh->triangleCount * 3, m_meshlets[part]);
+    }
+}
 
-    for (auto i = 0u; i < mtlCount; i++) {
-        logD("UMTL:   * Material {}", i);
-        reader.skip(4 * 19 + 1 * 2 + 4 * 10 + 1 * 2 + (4 + 4) * 16 + 1 * 66 + 4 * 4 + (4 + 4 + 1) * 5 + 4 * 5 + 1 * 1);
+void Scene::updateResidency() {
+    // streamed textures keep to their own budget, here they count as pinned
+    m_residency.setPinnedBytes(m_pinnedBytes + m_streamer.stats().residentBytes);
+    for (auto resource : m_residency.evict((size_t)m_settings.vramBudgetMB * 1024 * 1024)) {
+        if (resource.kind == Residency::Kind::Texture) {
+            m_lazy.evict(resource.handle);
+        } else {
+            m_geometry.evict(resource.handle);
+        }
+    }
+    m_stats.residency = m_residency.stats();
+}
 
-        int localTIDs[18];
-        std::string temp;
-        for (auto i = 0u; i < 18; i++) {
-            reader >> localTIDs[i];
-            temp += std::to_string(localTIDs[i]) + ", ";
+// what stays uploaded whatever the budget: every file's own textures and the meshes of parts loaded
+// whole. Shared ones count once
+void Scene::countPinnedBytes() {
+    m_pinnedTextures.clear();
+    m_pinnedMeshes.clear();
+    m_pinnedBytes = 0;
+    for (const auto& file : m_files) {
+        for (const auto& [idx, tex] : file.textures) {
+            if (!m_streamer.streams(tex.id) && m_pinnedTextures.insert(tex.id).second)
+                m_pinnedBytes += textures::getTextureSize(tex);
         }
-        temp.erase(temp.length() - 2);
+    }
+    for (auto i = 0u; i < m_models.size(); i++) {
+        const auto& model = m_models[i];
+        if (m_partGeometry[i] < 0 && model.meshCount > 0 && m_pinnedMeshes.insert(model.meshes[0].vboId[0]).second)
+            m_pinnedBytes += MeshCache::bytes(model.meshes[0]);
+    }
+    markShared();
+}
 
-        matTextureIDs.push_back(localTIDs[0]);
+// lazy textures and geometry that acquired a TextureCache or MeshCache object a pinned part holds too stay
+// uploaded when evicted, Residency leaves them to the pinned bytes
+void Scene::markShared() {
+    for (const auto& file : m_files) {
+        for (const auto& [idx, handle] : file.lazyTextures) {
+            m_residency.setShared(Residency::Kind::Texture, handle, m_pinnedTextures.contains(m_lazy.texture(handle).id));
+        }
+    }
+    for (auto i = 0u; i < m_models.size(); i++) {
+        if (m_partGeometry[i] < 0)
+            continue;
+        if (auto mesh = m_geometry.mesh(m_partGeometry[i]))
+            m_residency.setShared(Residency::Kind::Mesh, m_partGeometry[i], m_pinnedMeshes.contains(mesh->vboId[0]));
+    }
+}
 
-        logD("UMTL:     localTIDs list: [{}]", temp);
+void Scene::buildQueue(Vector3 camPos) {
+    auto frustum = Frustum::fromMatrices(rlGetMatrixModelview(), rlGetMatrixProjection());
+    auto count = m_models.size();
 
-        reader.skip(4 * reader.read<uint32_t>() * 3);
-        reader.skip(4 * 4 + (1 + 1 + 4 + 4 + 4 + 4) * 4 + 4 * 4 + 1 * 1 + 4 * 54 + 1 + 4 * 3);
-        if (umtlVer >= 0x95)
-            reader.skip(2);
+    m_queue.reset(count);
+    auto& keys = m_queue.keys();
 
-        auto nameStrLen = reader.read<uint16_t>();
-        char matName[nameStrLen];
-        reader.read((uint8_t*)matName, nameStrLen);
-        logD("UMTL:     Material name: {}", (char*)matName);
+    auto fill = [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; i++) {
+            const auto& box = m_bounds[i];
+            if (!frustum.containsBox(box)) {
+                keys[i] = RenderQueue::culledKey;
+                continue;
+            }
 
-        reader.skip(4);
-        reader.skip(4 * 20 * 4 + 4 * 20 * 3 * 2);
-        reader.skip(reader.read<uint32_t>() * 3);
-        reader.skip(reader.read<uint32_t>() * 3);
-        reader.skip(4 * 2 + 1 * 3 + 1 * 2 + 1 + 1 * 21);
-        reader.skip(4 * 4);
+            auto dx = (box.min.x + box.max.x) * 0.5f - camPos.x;
+            auto dy = (box.min.y + box.max.y) * 0.5f - camPos.y;
+            auto dz = (box.min.z + box.max.z) * 0.5f - camPos.z;
+            auto depth = std::sqrt(dx * dx + dy * dy + dz * dz);
 
-        auto localTID = reader.read<int32_t>();
-        logD("UMTL:     localTID: {}. Should be equal to localTIDs[0]", localTID);
+            auto pass = m_blended[i] ? RenderQueue::Pass::Blended : RenderQueue::Pass::Opaque;
+            auto texture = m_models[i].materials[0].maps[MATERIAL_MAP_DIFFUSE].texture.id;
+            keys[i] = RenderQueue::makeKey(pass, texture, depth, i);
+        }
+    };
 
-        reader.skip(1 * 2 + 2 * 2 + 1 * 2 + 4 * 6 + 1 * ((umtlVer >= 0x96) ? 16 : 15) + 4 * 2);
+    if (count >= parallelQueueThreshold) {
+        ThreadPool::shared().parallelFor(count, fill, 1024);
+    } else {
+        fill(0, count);
+    }
 
-        logD("UMTL:     Material ends at 0x{:08X}", reader.pos());
+    m_queue.sort();
+    m_stats.queued = m_queue.sorted().size();
+    m_stats.frustumCulled = count - m_stats.queued;
+}
+
+bool Scene::renderIndirect() {
+    if (m_indirectSupport == Support::Unknown)
+        m_indirectSupport = IndirectRenderer::isSupported() ? Support::Yes : Support::No;
+    if (m_indirectSupport == Support::No)
+        return false;
+
+    m_stats.indirect = true;
+    if (m_models.empty())
+        return true;
+
+    // streamed and lazy textures change what's resident, which the arrays' copies wouldn't follow
+    auto useArrays = m_settings.textureArrays && m_streamer.empty() && m_lazy.empty();
+    if (useArrays && !m_textureArrays.isBuilt()) {
+        std::vector<Texture> textures;
+        for (const auto& file : m_files) {
+            for (const auto& [idx, tex] : file.textures) {
+                textures.push_back(tex);
+            }
+        }
+        m_textureArrays.build(textures);
     }
+    if (!m_indirect.isBuilt() || m_indirect.partCount() != m_models.size() || m_indirect.usesTextureArrays() != useArrays)
+        m_indirect.build(m_models, m_bounds, useArrays ? &m_textureArrays : nullptr);
 
-    for (auto i = 0u; i < matTextureIDs.size(); i++) {
-        logD("UMTL: Material {}: Texture ID {}", i, matTextureIDs[i]);
+    auto frustum = Frustum::fromMatrices(rlGetMatrixModelview(), rlGetMatrixProjection());
+    if (m_settings.gpuCulling) {
+        m_indirect.cullGPU(frustum);
+    } else {
+        m_stats.drawn = m_indirect.cullCPU(frustum);
     }
 
-    // loading texture data
-    loadTextures(reader, goodTexCount);
+    auto drawStart = GetTime();
+    if (m_indirect.usesTextureArrays()) {
+        m_indirect.draw();
+    } else {
+        m_lean.begin();
+        m_indirect.draw();
+        m_lean.end();
+    }
+    m_stats.indirectDraws = m_indirect.lastDrawCalls();
+    updateDrawRate(GetTime() - drawStart, m_stats.indirectDraws);
 
-    // loading MESH
-    auto meshOffset = reader.find(std::string_view("HSEM", 4));
-    if (meshOffset == 0) {
-        logE("MESH: Couldn't find MESH!");
-        exit(1);
+    return true;
+}
+
+void Scene::drawPart(size_t idx) {
+    const auto& model = m_models[idx];
+    if (model.meshCount == 0)
+        return; // lazy geometry that isn't resident yet
+    auto triangleCount = model.meshes[0].triangleCount;
+
+    if (m_settings.meshletCulling && idx < m_meshlets.size()) {
+        const auto& part = m_meshlets[idx];
+        if (part.visibleIndices.empty())
+            return;
+        triangleCount = part.visibleIndices.size() / 3;
+    }
+
+    if (m_settings.leanDrawPath) {
+        m_lean.draw(model.meshes[0], model.materials[0], triangleCount);
+    } else if (triangleCount == model.meshes[0].triangleCount) {
+        DrawModel(model, {0, 0, 0}, 1.f, WHITE);
+    } else {
+        auto mesh = model.meshes[0];
+        mesh.triangleCount = triangleCount;
+        DrawMesh(mesh, model.materials[0], model.transform);
     }
-    logD("MESH: Found at 0x{:08X}", meshOffset);
-    reader.seek(meshOffset);
-    reader.skip(4); // MESH 4cc
-    uint32_t ver;
-    reader >> ver;
-    logD("MESH: Version: 0x{:X}", ver);
-    NUEX_ASSERT(ver >= 0x30) reader.skip(4); // ROTV
-    uint32_t len;                            // parts count
-    reader >> len;
-    logD("MESH: {} parts", len);
+    m_stats.drawn++;
+}
 
-    for (auto i = 0u; i < len; i++) {
-        logD("MESH:   * Part {}", i);
-        MeshPart part;
-        part.textureID = matTextureIDs[meshMaterials[i]];
+void Scene::buildMeshlets() {
+    NUEX_TRACE_SCOPE("buildMeshlets");
+    // parts of files loaded since the last build
+    auto first = std::min(m_meshlets.size(), m_models.size());
+    m_meshlets.resize(m_models.size());
+    ThreadPool::shared().parallelFor(m_models.size() - first, [this, first](size_t begin, size_t end) {
+        for (auto i = first + begin; i < first + end; i++) {
+            if (m_models[i].meshCount == 0)
+                continue; // built once the geometry is resident, see bindGeometry
+            const auto& mesh = m_models[i].meshes[0];
+            meshlets::build(mesh.vertices, mesh.vertexCount, mesh.indices, mesh.triangleCount * 3, m_meshlets[i]);
+        }
+    });
 
-        readPart(reader, part);
-        genMesh(part);
+    size_t total = 0;
+    for (const auto& part : m_meshlets) {
+        total += part.meshlets.size();
     }
+    logD("MESHLETS: Built {} meshlets for {} parts", total, m_meshlets.size());
 }
 
-void Scene::loadVertices(BinReader& reader, MeshPart& part) {
-    // VERTICES
-    uint32_t size;
-    reader >> size;
-    NUEX_ASSERT(size == 1 || size == 2);
+void Scene::cullMeshlets(Vector3 camPos) {
+    if (m_meshlets.size() != m_models.size())
+        buildMeshlets();
 
-    // VERTEX_SOMETHING
-    std::vector<MeshVertex> vertices;
-    part.vertexBufferID = m_refCounter;
-
-    for (auto i = 0; i < size; i++) {
-        uint32_t unk;
-        reader >> unk;
-        if (unk >> 3 * 8 == 0xC0) {
-            auto id = unk ^ 0xC0'00'00'00;
-            logD("MESH:     Reusing vertex buffer 0x{:X}", id);
-            if (i == 0)
-                part.vertexBufferID = id;
-            reader.skip(4 + 4);
-            continue;
+    auto frustum = Frustum::fromMatrices(rlGetMatrixModelview(), rlGetMatrixProjection());
+
+    std::vector<unsigned int> visible(m_meshlets.size());
+    ThreadPool::shared().parallelFor(
+        m_meshlets.size(),
+        [&](size_t begin, size_t end) {
+            for (auto i = begin; i < end; i++) {
+                visible[i] = meshlets::cull(m_meshlets[i], frustum, camPos);
+            }
+        },
+        64);
+
+    // uploads happen here rather than while drawing, the lean path keeps VAOs bound between draws
+    for (auto i = 0u; i < m_meshlets.size(); i++) {
+        auto& part = m_meshlets[i];
+        if (part.changed) {
+            rlUpdateVertexBufferElements(m_models[i].meshes[0].vboId[meshIndexBuffer], part.visibleIndices.data(),
+                                         part.visibleIndices.size() * sizeof(unsigned short), 0);
+            part.changed = false;
+            part.uploaded = true;
         }
-        if (!unk)
+        m_stats.meshlets += part.meshlets.size();
+        m_stats.meshletsVisible += visible[i];
+    }
+}
+
+void Scene::restoreIndices() {
+    for (auto i = 0u; i < m_meshlets.size(); i++) {
+        auto& part = m_meshlets[i];
+        if (!part.uploaded)
             continue;
 
-        reader.skip(4); // flags
-        uint32_t count;
-        reader >> count;
-        logD("MESH:     New vertex buffer 0x{:X} of length 0x{:X}", m_refCounter, count);
-
-        uint32_t nbAttribs;
-        reader >> nbAttribs;
-
-        std::vector<MeshAttrib> attribs;
-
-        for (auto i = 0u; i < nbAttribs; i++) {
-            MeshAttrib attrib;
-            reader >> attrib.valType >> attrib.varType;
-            // logD("attrib: {} {}", (int)attrib.valType, (int)attrib.varType);
-            reader.skip(1); // offset of the attrib
-            attribs.push_back(attrib);
-        }
-
-        for (auto i = 0u; i < count; i++) {
-            MeshVertex vertex;
-            vertex.pos = {0, 0, 0};
-            vertex.normal = {0, 0, 0};
-            vertex.uv = {0, 0};
-            vertex.color = {255, 255, 255, 255};
-
-            for (const auto& attrib : attribs) {
-                switch (attrib.valType) {
-                case MeshValType::Position: {
-                    switch (attrib.varType) {
-                    case MeshVarType::Vec4half: { // what
-                        half x, y, z;
-                        reader >> x >> y >> z;
-                        reader.skip(2);
-                        vertex.pos.x = (float)x;
-                        vertex.pos.y = (float)y;
-                        vertex.pos.z = (float)z;
-                    } break;
-                    case MeshVarType::Vec3f:
-                        // float x, y, z;
-                        reader >> vertex.pos.x >> vertex.pos.y >> vertex.pos.z;
-                        // reader >> x >> y >> z;
-                        // vertex.pos = {x, y, z};
-                        break;
-                    default:
-                        logE("Unhandled `position` varType: {}", (int)attrib.varType);
-                        reader.skip(utils::getVarSize(attrib.varType));
-                        break;
-                    }
-                } break;
-                case MeshValType::Normal: {
-                    switch (attrib.varType) {
-                    // case MeshVarType::Vec3f:
-                    //     reader >> vertex.normal.x >> vertex.normal.y >> vertex.normal.z;
-                    //     break;
-                    // case MeshVarType::Vec4f:
-                    //     reader >> vertex.normal.x >> vertex.normal.y >> vertex.normal.z;
-                    //     reader.skip(4);
-                    //     break;
-                    case MeshVarType::Vec4mini:
-                        unsigned char x, y, z;
-                        reader >> x >> y >> z;
-                        reader.skip(1); // w
-                        vertex.normal.x = utils::getMiniFloat(x);
-                        vertex.normal.y = utils::getMiniFloat(y);
-                        vertex.normal.z = utils::getMiniFloat(z);
-                        break;
-                    default:
-                        logE("Unhandled `normal` varType: {}", (int)attrib.varType);
-                        reader.skip(utils::getVarSize(attrib.varType));
-                        break;
-                    }
-                } break;
-                case MeshValType::ColorSet0: {
-                    switch (attrib.varType) {
-                    case MeshVarType::Col4char:
-                        reader >> vertex.color.r >> vertex.color.g >> vertex.color.b >> vertex.color.a;
-                        break;
-                    default:
-                        logE("Unhandled `color` varType: {}", (int)attrib.varType);
-                        reader.skip(utils::getVarSize(attrib.varType));
-                        break;
-                    }
-                } break;
-                case MeshValType::UVSet1: {
-                    switch (attrib.varType) {
-                    case MeshVarType::Vec4half: { // what
-                        half x, y;
-                        reader >> x >> y;
-                        reader.skip(4);
-                        vertex.uv.x = (float)x;
-                        vertex.uv.y = (float)y;
-                    } break;
-                    case MeshVarType::Vec2half: {
-                        half x, y;
-                        reader >> x >> y;
-                        vertex.uv.x = (float)x;
-                        vertex.uv.y = (float)y;
-                    } break;
-                    default:
-                        logE("Unhandled `uv` varType: {}", (int)attrib.varType);
-                        reader.skip(utils::getVarSize(attrib.varType));
-                        break;
-                    }
-                } break;
-                case MeshValType::Tangent:
-                case MeshValType::ColorSet1:
-                case MeshValType::Unknown:
-                case MeshValType::UVSet2:
-                case MeshValType::Unknown2:
-                case MeshValType::BlendIndices:
-                case MeshValType::BlendWeight:
-                case MeshValType::Unknown3:
-                case MeshValType::LightDirSet:
-                case MeshValType::LightColSet:
-                    // unused
-                    reader.skip(utils::getVarSize(attrib.varType));
-                    break;
-                default:
-                    logE("Unhandled valType {}", (int)attrib.valType);
-                    break;
-                }
-            }
+        const auto& mesh = m_models[i].meshes[0];
+        rlUpdateVertexBufferElements(mesh.vboId[meshIndexBuffer], mesh.indices, mesh.triangleCount * 3 * sizeof(unsigned short), 0);
+        part.uploaded = false;
+        // everything is visible again, the next cull will narrow it down
+        part.visible.assign(part.meshlets.size(), 1);
+        part.visibleIndices = part.indices;
+        part.changed = true;
+    }
+}
 
-            vertices.push_back(vertex);
+Scene::PreparedFile Scene::prepare(const std::string& filename, const ParseOptions& options, bool diskCache, bool watch) {
+    NUEX_TRACE_SCOPE("Scene::prepare");
+    PreparedFile prepared;
+    prepared.filename = filename;
+    // the cache key reuses the chunk hashes, so the file is only hashed once
+    std::vector<ChunkSpan> chunks;
+    if (watch || diskCache)
+        chunks = SceneParser::indexChunks(filename);
+    if (watch)
+        prepared.chunks = chunks;
+
+    if (diskCache) {
+        prepared.cacheKey = SceneCache::makeKey(filename, chunks);
+        auto cache = std::make_unique<SceneCache>();
+        if (prepared.cacheKey && cache->open(*prepared.cacheKey)) {
+            for (const auto& part : cache->parts()) {
+                prepared.meshHashes.push_back(MeshCache::hash(
+                    (const float*)cache->at(part.vertices), (const float*)cache->at(part.normals),
+                    (const float*)cache->at(part.texcoords), cache->at(part.colors), part.vertexCount,
+                    (const uint16_t*)cache->at(part.indices), part.indexCount));
+            }
+            prepared.cache = std::move(cache);
+            prepared.ok = true;
+            return prepared;
         }
+    }
+
+    if (!SceneParser(options).parse(filename, prepared.data, &prepared.error))
+        return prepared;
+    hashParts(prepared);
+    prepared.ok = true;
+    return prepared;
+}
 
-        reader.skip(4); // byteOffset
+Scene::PreparedFile Scene::prepareReload(const std::string& filename, ParseOptions options, bool diskCache,
+                                         const std::vector<ChunkSpan>& previous) {
+    NUEX_TRACE_SCOPE("Scene::prepareReload");
+    PreparedFile prepared;
+    prepared.filename = filename;
+    prepared.chunks = SceneParser::indexChunks(filename);
+    if (prepared.chunks.empty()) {
+        prepared.error = {"FILE", 0, "couldn't open the file"};
+        return prepared;
+    }
 
-        if (i == 0)
-            m_vertexBuffers[m_refCounter] = vertices;
-        m_refCounter++;
+    // moved counts as changed too, streamed textures read their blobs by offset
+    auto changed = [&](std::string_view name) {
+        auto find = [&](const std::vector<ChunkSpan>& chunks) {
+            return std::find_if(chunks.begin(), chunks.end(), [&](const auto& chunk) { return chunk.name == name; });
+        };
+        auto before = find(previous), after = find(prepared.chunks);
+        return before == previous.end() || after == prepared.chunks.end() || !(*before == *after);
+    };
+    // TXGH decides the texture count and where the parser's buffer ids start, so it affects both
+    options.readTextures = changed("TXGH") || changed("TEXTURES");
+    options.readMeshes = changed("TXGH") || changed("DISP") || changed("UMTL") || changed("MESH");
+    prepared.texturesRead = options.readTextures;
+    prepared.meshesRead = options.readMeshes;
+    if (!options.readTextures && !options.readMeshes) {
+        prepared.ok = true;
+        return prepared;
     }
+
+    if (diskCache)
+        prepared.cacheKey = SceneCache::makeKey(filename, prepared.chunks);
+    if (!SceneParser(options).parse(filename, prepared.data, &prepared.error))
+        return prepared;
+    hashParts(prepared);
+    prepared.ok = true;
+    return prepared;
 }
 
-void Scene::loadIndices(BinReader& reader, MeshPart& part) {
-    uint32_t something;
-    reader >> something;
+void Scene::hashParts(PreparedFile& prepared) {
+    for (const auto& part : prepared.data.parts) {
+        // hashed once decoded
+        if (part.deferred) {
+            prepared.meshHashes.push_back(0);
+            continue;
+        }
+        prepared.meshHashes.push_back(MeshCache::hash(part.positions.data(), part.normals.data(), part.texcoords.data(),
+                                                      part.colors.data(), part.positions.size() / 3, part.indices.data(),
+                                                      part.indices.size()));
+    }
+}
 
-    if (something >> 3 * 8 == 0xC0) { // reusing an index buffer
-        auto id = something ^ 0xC0'00'00'00;
-        logD("MESH:     Reusing index buffer 0x{:X}", id);
-        part.indexBufferID = id;
-        reader.skip(4);
-    } else {
-        reader.skip(4); // flags
-        uint32_t count, size;
-        reader >> count >> size;
-        logD("MESH:     New index buffer 0x{:X} of length 0x{:X}", m_refCounter, count);
-        NUEX_ASSERT(size == 2);
+bool Scene::load(const std::vector<std::string>& filenames, std::vector<LoadFailure>* failures) {
+    NUEX_TRACE_SCOPE("Scene::load");
+
+    ParseOptions options;
+    if (m_settings.streamTextures)
+        options.partialTextureSize = TextureStreamer::initialSize;
+    options.deferGeometry = m_settings.lazyGeometry;
+    auto diskCache = diskCacheEnabled();
+    auto watch = m_settings.hotReload;
+
+    // parsing (or hashing and mapping the cached copy) runs on the pool, GL work stays on this thread
+    std::vector<std::future<PreparedFile>> pending;
+    std::unordered_set<std::string> requested;
+    for (const auto& filename : filenames) {
+        if (std::any_of(m_files.begin(), m_files.end(), [&](const auto& file) { return file.filename == filename; }) ||
+            !requested.insert(filename).second) {
+            logW("{} is already loaded, skipping it", filename);
+            continue;
+        }
+        logD("Loading a scene from {}", filename);
+        pending.push_back(ThreadPool::shared().submit(
+            [filename, options, diskCache, watch]() { return prepare(filename, options, diskCache, watch); }));
+    }
 
-        std::vector<unsigned short> indices;
+    auto ok = true;
+    for (auto& future : pending) {
+        auto prepared = future.get();
+        if (!prepared.ok) {
+            logE("Couldn't load {}: {}", prepared.filename, prepared.error.message());
+            if (failures)
+                failures->push_back({prepared.filename, prepared.error});
+            ok = false;
+            continue;
+        }
 
-        indices.resize(count);
+        LoadedFile file;
+        file.filename = prepared.filename;
+        file.firstPart = m_models.size();
+        file.chunks = std::move(prepared.chunks);
 
-        for (auto i = 0u; i < count; i++) {
-            reader >> indices[i];
+        if (prepared.cache) {
+            loadCached(*prepared.cache, prepared.meshHashes, file);
+        } else {
+            loadTextures(prepared.data, file);
+            for (auto i = 0u; i < prepared.data.parts.size(); i++) {
+                genMesh(prepared.data.parts[i], prepared.meshHashes[i], file);
+            }
+            if (prepared.cacheKey)
+                writeCache(*prepared.cacheKey, file);
         }
 
-        part.indexBufferID = m_refCounter;
-        m_indexBuffers[m_refCounter] = indices;
-        m_refCounter++;
+        file.partCount = m_models.size() - file.firstPart;
+        if (!file.chunks.empty())
+            m_watcher.add(file.filename);
+        m_files.push_back(std::move(file));
     }
+    if (!m_streamer.empty())
+        logD("TEXTURES: {} textures are streamed, texture arrays stay off", m_streamer.stats().textures);
 
-    reader >> part.indexOffset >> part.indexCount >> part.vertexOffset;
-    reader.skip(2);
-    reader >> part.vertexCount;
-    // logD("indexOffset {}, indexCount {}, verticesOffset {}, verticesCount {}", part.indexOffset, part.indexCount,
-    //      part.vertexOffset, part.vertexCount);
+    resetDerived();
+    if (m_settings.meshletCulling)
+        buildMeshlets();
+    return ok;
 }
 
-void Scene::genMesh(const MeshPart& part) {
-    Mesh mesh = {0};
+bool Scene::unload(const std::string& filename) {
+    auto it = std::find_if(m_files.begin(), m_files.end(), [&](const auto& file) { return file.filename == filename; });
+    if (it == m_files.end())
+        return false;
 
-    mesh.vertexCount = part.vertexCount;
-    mesh.triangleCount = part.indexCount / 3;
-    // logD("vertex count {} tri count {}", mesh.vertexCount, mesh.triangleCount);
+    logD("Unloading {}", filename);
+    m_watcher.remove(filename);
+    unloadParts(it->firstPart, it->partCount);
+    releaseTextures(*it);
 
-    mesh.vertices = (float*)MemAlloc(sizeof(float) * 3 * mesh.vertexCount);
-    mesh.normals = (float*)MemAlloc(sizeof(float) * 3 * mesh.vertexCount);
-    mesh.texcoords = (float*)MemAlloc(sizeof(float) * 2 * mesh.vertexCount);
-    mesh.colors = (uint8_t*)MemAlloc(sizeof(uint8_t) * 4 * mesh.vertexCount);
-    mesh.indices = (unsigned short*)MemAlloc(sizeof(unsigned short) * part.indexCount);
+    for (auto next = it + 1; next != m_files.end(); next++) {
+        next->firstPart -= it->partCount;
+    }
+    m_files.erase(it);
 
-    mesh.animNormals = nullptr;
-    mesh.animVertices = nullptr;
-    mesh.boneIds = nullptr;
-    mesh.boneWeights = nullptr;
-    mesh.tangents = nullptr;
-    mesh.texcoords2 = nullptr;
+    resetDerived();
+    return true;
+}
 
-    // logD("index id 0x{:X} vert id 0x{:X}", part.indexBufferID, part.vertexBufferID);
+void Scene::clear() {
+    // reads still running only hold copies, their results are dropped with the futures
+    m_reloads.clear();
+    unloadParts(0, m_models.size());
+    for (auto& file : m_files) {
+        m_watcher.remove(file.filename);
+        releaseTextures(file);
+    }
+    m_files.clear();
+    m_meshlets.clear();
+    m_streamer.reset();
+    m_lazy.reset();
+    m_geometry.reset();
+    m_residency.reset();
+    resetDerived();
+}
 
-    const auto& indices = m_indexBuffers[part.indexBufferID];
-    const auto& vertices = m_vertexBuffers[part.vertexBufferID];
-    // logD("actual indices size {} vert size {}", indices.size(), vertices.size());
-    // memcpy(mesh.indices, indices.data() + part.indexOffset, sizeof(unsigned short) * part.indexCount);
-    for (auto i = 0u; i < part.indexCount; i++) {
-        // mesh.indices[i] = indices[i];
-        mesh.indices[i] = indices[part.indexOffset + i];
-        // logD("{}: {}", i, mesh.indices[i]);
+// streamed textures keep reading the source file, a cache would only hold their low mips. Lazy textures
+// and lazy geometry would be missing from it
+bool Scene::diskCacheEnabled() const {
+    return m_settings.diskCache && !m_settings.streamTextures && !m_settings.lazyTextures && !m_settings.lazyGeometry;
+}
+
+std::vector<std::string> Scene::files() const {
+    std::vector<std::string> names;
+    for (const auto& file : m_files) {
+        names.push_back(file.filename);
     }
+    return names;
+}
 
-    for (auto i = 0u; i < part.vertexCount; i++) {
-        auto& vertex = vertices[part.vertexOffset + i];
-        mesh.vertices[i * 3 + 0] = vertex.pos.x;
-        mesh.vertices[i * 3 + 1] = vertex.pos.y;
-        mesh.vertices[i * 3 + 2] = vertex.pos.z;
+void Scene::update() {
+    std::vector<std::string> again;
+    for (auto it = m_reloads.begin(); it != m_reloads.end();) {
+        if (it->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            it++;
+            continue;
+        }
+        auto prepared = it->result.get();
+        applyReload(prepared);
+        if (it->again)
+            again.push_back(it->filename);
+        it = m_reloads.erase(it);
+    }
 
-        mesh.normals[i * 3 + 0] = vertex.normal.x;
-        mesh.normals[i * 3 + 1] = vertex.normal.y;
-        mesh.normals[i * 3 + 2] = vertex.normal.z;
+    for (const auto& filename : again) {
+        startReload(filename);
+    }
+    for (const auto& filename : m_watcher.poll(reloadSettle)) {
+        startReload(filename);
+    }
+}
+
+void Scene::startReload(const std::string& filename) {
+    auto file = std::find_if(m_files.begin(), m_files.end(), [&](const auto& file) { return file.filename == filename; });
+    if (file == m_files.end())
+        return;
+    auto pending =
+        std::find_if(m_reloads.begin(), m_reloads.end(), [&](const auto& reload) { return reload.filename == filename; });
+    if (pending != m_reloads.end()) {
+        pending->again = true;
+        return;
+    }
 
-        mesh.texcoords[i * 2 + 0] = vertex.uv.x;
-        mesh.texcoords[i * 2 + 1] = vertex.uv.y;
+    logD("{} changed on disk, reloading what changed", filename);
+    ParseOptions options;
+    if (m_settings.streamTextures)
+        options.partialTextureSize = TextureStreamer::initialSize;
+    options.deferGeometry = m_settings.lazyGeometry;
+    auto diskCache = diskCacheEnabled();
+    m_reloads.push_back({filename, ThreadPool::shared().submit([filename, options, diskCache, chunks = file->chunks]() {
+                             return prepareReload(filename, options, diskCache, chunks);
+                         })});
+}
 
-        mesh.colors[i * 4 + 0] = vertex.color.r;
-        mesh.colors[i * 4 + 1] = vertex.color.g;
-        mesh.colors[i * 4 + 2] = vertex.color.b;
-        mesh.colors[i * 4 + 3] = 255;
-        // mesh.colors[i * 4 + 3] = vertex.color.a;
+void Scene::applyReload(PreparedFile& prepared) {
+    NUEX_TRACE_SCOPE("Scene::reload");
+    auto it = std::find_if(m_files.begin(), m_files.end(), [&](const auto& file) { return file.filename == prepared.filename; });
+    if (it == m_files.end())
+        return; // unloaded meanwhile
+    if (!prepared.ok) {
+        logW("Couldn't reload {}, keeping what was loaded: {}", prepared.filename, prepared.error.message());
+        return;
+    }
+    if (!prepared.texturesRead && !prepared.meshesRead) {
+        logD("{} was written but none of its chunks changed", prepared.filename);
+        it->chunks = std::move(prepared.chunks);
+        return;
     }
 
-    UploadMesh(&mesh, false);
+    auto& old = *it;
+    LoadedFile file;
+    file.filename = old.filename;
+    file.firstPart = old.firstPart;
+    file.chunks = std::move(prepared.chunks);
 
-    auto model = LoadModelFromMesh(mesh);
-    logD("MESH:     Part texture id: {}", part.textureID);
-    if (part.textureID > 2 && m_textures.contains(part.textureID)) {
-        logD("MESH:     Applying texture: {}", part.textureID);
-        model.materials[0].maps[MATERIAL_MAP_DIFFUSE].texture = m_textures[part.textureID];
+    // the new version is set up while the old one still holds its references, so textures and meshes whose
+    // bytes didn't change come out of TextureCache and MeshCache instead of being decoded and uploaded again
+    if (prepared.texturesRead) {
+        loadTextures(prepared.data, file);
+    } else {
+        file.textures = std::move(old.textures);
+        file.textureHashes = std::move(old.textureHashes);
+        file.lazyTextures = std::move(old.lazyTextures);
+        old.textures.clear();
+        old.lazyTextures.clear();
     }
-    m_models.push_back(model);
 
-    logD("MESH:     Mesh built successfully");
-}
-
-void Scene::readPart(BinReader& reader, MeshPart& part) {
-    loadVertices(reader, part);
-
-    uint32_t fastBlendVBSSize;
-    reader >> fastBlendVBSSize;
-    NUEX_ASSERT(fastBlendVBSSize == 0);
-    loadIndices(reader, part);
-
-    // skip the remaining part
-
-    reader.skip(4);
-
-    uint32_t skinMtxMapSize;
-    reader >> skinMtxMapSize;
-    reader.skip(skinMtxMapSize);
-    if (skinMtxMapSize > 0) {
-        m_refCounter++;
-    }
-
-    // dynamic parts
-    uint32_t dynamicBufferCheck;
-    reader >> dynamicBufferCheck;
-    if (dynamicBufferCheck != 0) {
-        logD("MESH:     Reading relative position list (at 0x{:08X})", reader.pos());
-        reader.skip(4);
-        int num = 1;
-        int num2 = 0;
-        while (reader.read<uint32_t>() != 0) {
-            reader.skip(4);
-            num++;
-        }
-        logD("MESH:     RelPos lists: {}", num);
-        for (auto i = 0u; i < num; i++) {
-            auto num3 = reader.read<int>();
-            logD("MESH:       * RelPos list {} (type {})", i, num3);
-            if (num3 == 0) {
-                reader.skip(5 + 4 + 4);
-                auto num4 = reader.read<int>();
-                logD("MESH:         RelPos size: {}", num4);
-                reader.skip(num4);
-                num2++;
-                auto num5 = reader.read<int>();
-                logD("MESH:         RelPos tupels: {}", num5);
-                reader.skip(4 * num5);
-                if (num5 > 0) {
-                    num2++;
-                }
-                num2++;
+    if (prepared.meshesRead) {
+        auto appended = m_models.size();
+        for (auto i = 0u; i < prepared.data.parts.size(); i++) {
+            genMesh(prepared.data.parts[i], prepared.meshHashes[i], file);
+        }
+        file.partCount = m_models.size() - appended;
+
+        // swap the new parts in where the old ones were
+        unloadParts(old.firstPart, old.partCount);
+        appended -= old.partCount;
+        auto moveInto = [&](auto& items) {
+            std::rotate(items.begin() + file.firstPart, items.begin() + appended, items.end());
+        };
+        moveInto(m_models);
+        moveInto(m_bounds);
+        moveInto(m_blended);
+        moveInto(m_partTextures);
+        moveInto(m_partGeometry);
+        for (auto next = it + 1; next != m_files.end(); next++) {
+            next->firstPart = next->firstPart - old.partCount + file.partCount;
+        }
+        m_meshlets.resize(std::min(m_meshlets.size(), file.firstPart));
+    } else {
+        // same parts, rebound to the reloaded textures
+        file.partCount = old.partCount;
+        for (auto i = file.firstPart; i < file.firstPart + file.partCount; i++) {
+            auto texture = m_partTextures[i];
+            auto& map = m_models[i].materials[0].maps[MATERIAL_MAP_DIFFUSE];
+            if (texture >= 0 && file.textures.contains(texture)) {
+                map.texture = file.textures[texture];
             } else {
-                num2++;
-                num2++;
-                reader.skip(12 * num3 + 21);
+                map.texture = {rlGetTextureIdDefault(), 1, 1, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
             }
         }
-
-        m_refCounter += num2;
     }
 
-    reader.skip(4 + 16 + 16 + 4 + 4);
+    releaseTextures(old);
+    logD("Reloaded {}: {} textures, {} parts re-read", file.filename, prepared.data.textures.size(), prepared.data.parts.size());
+    if (prepared.cacheKey)
+        writeCache(*prepared.cacheKey, file);
+    old = std::move(file);
 
-    // unk VERTEX_SOMETHING
-    uint32_t unk;
-    reader >> unk;
-    NUEX_ASSERT(unk == 0);
+    resetDerived();
+    if (m_settings.meshletCulling)
+        buildMeshlets();
+}
 
-    reader.skip(4 + 4);
+void Scene::unloadParts(size_t first, size_t count) {
+    // meshes are shared through MeshCache and go with their last reference, lazy geometry holds its own
+    for (auto i = first; i < first + count; i++) {
+        auto& model = m_models[i];
+        if (m_partGeometry[i] >= 0) {
+            model.meshCount = 0;
+            m_geometry.remove(m_partGeometry[i]);
+        } else if (MeshCache::shared().release(model.meshes[0])) {
+            model.meshCount = 0;
+        }
+        UnloadModel(model);
+    }
 
-    // unk INDICES
-    uint32_t unkIndexesUnk;
-    reader >> unkIndexesUnk;
-    NUEX_ASSERT(unkIndexesUnk == 0);
+    m_models.erase(m_models.begin() + first, m_models.begin() + first + count);
+    m_bounds.erase(m_bounds.begin() + first, m_bounds.begin() + first + count);
+    m_blended.erase(m_blended.begin() + first, m_blended.begin() + first + count);
+    m_partTextures.erase(m_partTextures.begin() + first, m_partTextures.begin() + first + count);
+    m_partGeometry.erase(m_partGeometry.begin() + first, m_partGeometry.begin() + first + count);
+    if (m_meshlets.size() >= first + count) {
+        m_meshlets.erase(m_meshlets.begin() + first, m_meshlets.begin() + first + count);
+    } else {
+        m_meshlets.resize(std::min(m_meshlets.size(), first));
+    }
+}
 
-    reader.skip(4 + 4 + 4);
+void Scene::releaseTextures(LoadedFile& file) {
+    // textures are shared through TextureCache like meshes, streamed ones are the file's own
+    for (auto& [i, tex] : file.textures) {
+        if (!TextureCache::shared().release(tex.id)) {
+            m_streamer.remove(tex.id);
+            UnloadTexture(tex);
+        }
+    }
+    file.textures.clear();
 
-    m_refCounter++;
+    for (auto [i, handle] : file.lazyTextures) {
+        m_lazy.remove(handle);
+    }
+    file.lazyTextures.clear();
 }
 
-void Scene::loadTextures(BinReader& reader, int count) {
-    auto firstTex = reader.find(std::string_view("DDS ", 4));
-    if (firstTex == 0) {
-        logW("TEXTURES: There are no textures in the file!");
-        return;
+// per-part state of the renderers, rebuilt for the new set of parts when next used
+void Scene::resetDerived() {
+    m_occlusion.reset();
+    m_indirect.reset();
+    m_textureArrays.reset();
+    countPinnedBytes();
+}
+
+static int getPixelFormat(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::DXT1:
+        return PIXELFORMAT_COMPRESSED_DXT1_RGB;
+    case TextureFormat::DXT1Alpha:
+        return PIXELFORMAT_COMPRESSED_DXT1_RGBA;
+    case TextureFormat::DXT5:
+        return PIXELFORMAT_COMPRESSED_DXT5_RGBA;
+    default:
+        return 0;
     }
+}
 
-    logD("TEXTURES: Textures start address found at 0x{:08X}", firstTex);
-    reader.seek(firstTex);
+void Scene::loadTextures(SceneData& data, LoadedFile& file) {
+    auto& blobs = data.textures;
+    auto count = blobs.size();
+
+    // identical payloads (within this file or anything loaded before) are decoded and uploaded once.
+    // Partially read blobs can't be told apart by content and stay out of the cache
+    auto& cache = TextureCache::shared();
+    std::vector<bool> decode(count, false);
+    std::unordered_map<uint64_t, unsigned int> firstUse;
+    auto reused = 0u;
+    for (auto i = 0u; i < count; i++) {
+        auto& blob = blobs[i];
+        if (blob.partial)
+            continue;
+        // decoded once a part using it shows up, see updateLazyTextures
+        if (m_settings.lazyTextures) {
+            file.lazyTextures[i] = m_lazy.add(std::move(blob));
+            continue;
+        }
+        file.textureHashes[i] = blob.hash;
+        if (auto tex = cache.acquire(blob.hash)) {
+            file.textures[i] = *tex;
+            reused++;
+        } else if (firstUse.try_emplace(blob.hash, i).second) {
+            decode[i] = true;
+        }
+    }
 
-    reader.setEndianness(Endianness::Little);
+    // decoding and mip generation don't need GL, so they run on the pool
+    std::vector<Image> images(count);
+    ThreadPool::shared().parallelFor(count, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; i++) {
+            const auto& blob = blobs[i];
+            if (!decode[i])
+                continue;
+            NUEX_TRACE_SCOPE("decodeTexture");
+            NUEX_TRACE_BYTES(blob.size);
+            images[i] = textures::decode(blob);
+        }
+    });
 
     for (auto i = 0u; i < count; i++) {
-        auto startPos = reader.pos();
-        logD("TEXTURES:   * Loading texture {} at 0x{:08X}", i, startPos);
-
-        auto dataLen = 0u;
-
-        bool skip = false;
-
-        reader.seek(startPos + 84);
-        auto type = reader.read<uint32_t>();
-        switch (type) {
-        case 0x31'54'58'44: { // DXT1
-            logD("TEXTURES:     Texture type: DXT1");
-            int num1, num2;
-            reader.seek(startPos + 12);
-            reader >> num1 >> num2;
-            reader.seek(startPos + 28);
-            int int32_1 = reader.read<uint32_t>();
-            reader.seek(startPos + 112);
-            int int32_2 = reader.read<uint32_t>();
-            logD("TEXTURES:     Texture info: {}x{}, {} mips, cubeMapFlags: {:08X}", num2, num1, int32_1, int32_2);
-            int num3 = num1 * num2 >> 1;
-            for (int index = 1; index < int32_1; ++index) {
-                num1 = num1 >> 1 < 4 ? 4 : num1 >> 1;
-                num2 = num2 >> 1 < 4 ? 4 : num2 >> 1;
-                num3 += num1 * num2 >> 1;
-            }
-            if (int32_2 != 0)
-                num3 *= 6;
-            num3 += 128;
-            dataLen = num3;
-        } break;
-        case 0x35'54'58'44: { // DXT5
-            logD("TEXTURES:     Texture type: DXT5");
-            reader.seek(startPos + 12);
-            int num1, num2;
-            reader >> num1 >> num2;
-            reader.seek(startPos + 28);
-            int int32_1 = reader.read<uint32_t>();
-            reader.seek(startPos + 112);
-            int int32_2 = reader.read<uint32_t>();
-            logD("TEXTURES:     Texture info: {}x{}, {} mips, cubeMapFlags: {:08X}", num2, num1, int32_1, int32_2);
-            int num3 = num1 * num2;
-            for (int index = 1; index < int32_1; ++index) {
-                num1 = num1 >> 1 < 4 ? 4 : num1 >> 1;
-                num2 = num2 >> 1 < 4 ? 4 : num2 >> 1;
-                num3 += num1 * num2;
-            }
-            if (int32_2 != 0)
-                num3 *= 6;
-            num3 += 128;
-            dataLen = num3;
-        } break;
-        case 116: { // D3D
-            logD("TEXTURES:     Texture type: D3D");
-            reader.seek(startPos + 12);
-            int int32_1, int32_2;
-            reader >> int32_1 >> int32_2;
-            reader.seek(startPos + 28);
-            int int32_3 = reader.read<uint32_t>();
-            logD("TEXTURES:     Texture info: {}x{}, {} mips", int32_2, int32_1, int32_3);
-            if (int32_3 != 1) {
-                logW("TEXTURES:     D3D mipmaps = {}, skipping!", int32_3);
-                skip = true;
-            }
-            int dformat74FileSize = int32_1 * int32_2 * 16 + 128;
-            dataLen = dformat74FileSize;
-        } break;
-        default:
-            logE("TEXTURES:     Unknown texture type 0x{:08X}", type);
-            // exit(1);
+        const auto& blob = blobs[i];
+        if (blob.partial) {
+            file.textures[i] = m_streamer.add(file.filename, blob.offset, blob.data.get(), getPixelFormat(blob.format),
+                                              blob.width, blob.height, blob.mips, blob.firstLevel);
+            continue;
+        }
+        if (!decode[i])
+            continue;
+
+        auto& img = images[i];
+        if (blob.format == TextureFormat::FloatRGBA)
+            logD("TEXTURES:   * Texture {} converted to {}", i, img.format == PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 ? "RGBA8" : "RGBA16F");
+        logD("TEXTURES:   * Texture {}: {}x{}, {} mips", i, img.width, img.height, img.mipmaps);
+        {
+            NUEX_TRACE_SCOPE("uploadTexture");
+            NUEX_TRACE_BYTES(GetPixelDataSize(img.width, img.height, img.format));
+            file.textures[i] = cache.insert(blob.hash, textures::upload(img));
         }
+        UnloadImage(img);
+    }
+
+    // duplicates within this file share the first copy's upload
+    for (auto i = 0u; i < count; i++) {
+        if (blobs[i].partial || decode[i] || file.textures.count(i) || file.lazyTextures.count(i))
+            continue;
+        file.textures[i] = *cache.acquire(blobs[i].hash);
+        reused++;
+    }
+    logD("TEXTURES: {} of {} textures reused from the cache, {} left for when they're visible", reused, count,
+         file.lazyTextures.size());
+}
 
-        logD("TEXTURES:     Texture data length: 0x{:08X}", dataLen);
+void Scene::genMesh(const ScenePart& part, uint64_t hash, LoadedFile& file) {
+    NUEX_TRACE_SCOPE("genMesh");
+    BoundingBox bounds = {{part.boundsMin.x, part.boundsMin.y, part.boundsMin.z},
+                          {part.boundsMax.x, part.boundsMax.y, part.boundsMax.z}};
+    if (part.deferred) {
+        addPart({0}, part.texture, part.blended, bounds, file, m_geometry.add(file.filename, part));
+        return;
+    }
+    if (auto shared = MeshCache::shared().acquire(hash)) {
+        addPart(*shared, part.texture, part.blended, bounds, file);
+        return;
+    }
 
-        reader.seek(startPos);
+    auto mesh = MeshCache::upload(part);
+    addPart(MeshCache::shared().insert(hash, mesh), part.texture, part.blended, bounds, file);
+}
 
-        auto data = std::make_unique<uint8_t[]>(dataLen);
-        reader.read(data.get(), dataLen);
+// `mesh` holds a reference in MeshCache (or LazyGeometry), the model only borrows it
+void Scene::addPart(Mesh mesh, int texture, bool blended, const BoundingBox& bounds, LoadedFile& file, int geometry) {
+    auto model = LoadModelFromMesh(mesh);
+    if (geometry >= 0)
+        model.meshCount = 0; // the mesh slot is filled in by bindGeometry
+    if (texture >= 0 && file.textures.contains(texture)) {
+        logD("MESH:     Applying texture: {}", texture);
+        model.materials[0].maps[MATERIAL_MAP_DIFFUSE].texture = file.textures[texture];
+        m_partTextures.push_back(texture);
+    } else if (texture >= 0 && file.lazyTextures.contains(texture)) {
+        m_partTextures.push_back(texture); // the placeholder until it's visible
+    } else {
+        m_partTextures.push_back(-1);
+    }
+    m_models.push_back(model);
+    m_bounds.push_back(bounds);
+    m_blended.push_back(blended);
+    m_partGeometry.push_back(geometry);
+}
 
-        reader.seek(startPos + dataLen);
+void Scene::loadCached(const SceneCache& cache, const std::vector<uint64_t>& meshHashes, LoadedFile& file) {
+    NUEX_TRACE_SCOPE("Scene::loadCached");
+    auto start = GetTime();
+    auto& textureCache = TextureCache::shared();
+    for (const auto& entry : cache.textures()) {
+        auto tex = textureCache.acquire(entry.hash);
+        if (!tex) {
+            tex = textureCache.insert(entry.hash, textures::uploadLevels(cache.at(entry.data), entry.format, entry.width,
+                                                                         entry.height, entry.mips));
+        }
+        file.textures[entry.index] = *tex;
+        file.textureHashes[entry.index] = entry.hash;
+    }
 
-        if (skip)
+    // raylib owns and frees mesh arrays, so they're copied out of the mapping
+    auto copy = [&](uint64_t offset, size_t size) {
+        auto ptr = MemAlloc(std::max(size, (size_t)1));
+        std::memcpy(ptr, cache.at(offset), size);
+        return ptr;
+    };
+    for (auto i = 0u; i < cache.parts().size(); i++) {
+        const auto& part = cache.parts()[i];
+        auto hash = meshHashes[i];
+        BoundingBox bounds = {{part.boundsMin[0], part.boundsMin[1], part.boundsMin[2]},
+                              {part.boundsMax[0], part.boundsMax[1], part.boundsMax[2]}};
+        if (auto shared = MeshCache::shared().acquire(hash)) {
+            addPart(*shared, part.texture, part.blended, bounds, file);
             continue;
+        }
 
-        auto img = LoadImageFromMemory(".dds", data.get(), dataLen);
-        auto tex = LoadTextureFromImage(img);
-        SetTextureFilter(tex, TEXTURE_FILTER_BILINEAR);
-        m_textures[i] = tex;
+        Mesh mesh = {0};
+        mesh.vertexCount = part.vertexCount;
+        mesh.triangleCount = part.indexCount / 3;
+        mesh.vertices = (float*)copy(part.vertices, part.vertexCount * sizeof(float) * 3);
+        mesh.normals = (float*)copy(part.normals, part.vertexCount * sizeof(float) * 3);
+        mesh.texcoords = (float*)copy(part.texcoords, part.vertexCount * sizeof(float) * 2);
+        mesh.colors = (uint8_t*)copy(part.colors, part.vertexCount * 4);
+        mesh.indices = (unsigned short*)copy(part.indices, part.indexCount * sizeof(unsigned short));
+        UploadMesh(&mesh, false);
+        addPart(MeshCache::shared().insert(hash, mesh), part.texture, part.blended, bounds, file);
     }
 
-    reader.setEndianness(Endianness::Big);
+    logD("CACHE: Loaded {} parts and {} textures from the cache in {:.0f} ms", cache.parts().size(), cache.textures().size(),
+         (GetTime() - start) * 1000);
 }
 
-void Scene::cleanup() {
-    for (auto& model : m_models) {
-        UnloadModel(model);
+void Scene::writeCache(const SceneCache::Key& key, const LoadedFile& file) {
+    NUEX_TRACE_SCOPE("Scene::writeCache");
+    // parts read with lazy geometry that were never in view
+    for (auto i = file.firstPart; i < file.firstPart + file.partCount; i++) {
+        if (m_models[i].meshCount == 0) {
+            logD("CACHE: {} has parts that were never decoded, not caching it", file.filename);
+            return;
+        }
     }
 
-    for (auto& [i, tex] : m_textures) {
-        UnloadTexture(tex);
+    SceneCache::Writer writer;
+
+    std::unordered_set<uint64_t> written;
+    for (const auto& [idx, tex] : file.textures) {
+        if (tex.id == 0)
+            continue;
+        auto hash = file.textureHashes.at(idx);
+        std::vector<uint8_t> data;
+        if (written.insert(hash).second) {
+            data = textures::download(tex);
+            if (data.empty()) {
+                logW("CACHE: Texture {} has a format the cache can't hold ({}), not caching this file", idx, tex.format);
+                return;
+            }
+        }
+        writer.addTexture({idx, tex.format, tex.width, tex.height, tex.mipmaps, 0, hash, 0, 0}, std::move(data));
     }
+
+    for (auto i = file.firstPart; i < file.firstPart + file.partCount; i++) {
+        const auto& mesh = m_models[i].meshes[0];
+        const auto& box = m_bounds[i];
+        SceneCache::Part part = {(uint32_t)mesh.vertexCount,
+                                 (uint32_t)mesh.triangleCount * 3,
+                                 m_partTextures[i],
+                                 m_blended[i],
+                                 {box.min.x, box.min.y, box.min.z},
+                                 {box.max.x, box.max.y, box.max.z}};
+        writer.addPart(part, mesh.vertices, mesh.normals, mesh.texcoords, mesh.colors, mesh.indices);
+    }
+
+    writer.write(key, (uint64_t)m_settings.diskCacheMB * 1024 * 1024);
 }
@@ -1,48 +1,193 @@
 #pragma once
+#include <future>
+#include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <raylib.h>
-#include "BinReader.hpp"
-#include "types.hpp"
-
-struct MeshVertex {
-    Vec3f pos;
-    Vec3f normal;
-    Col4u color;
-    Vec2f uv;
+#include "FileWatcher.hpp"
+#include "IndirectRenderer.hpp"
+#include "LazyGeometry.hpp"
+#include "LazyTextures.hpp"
+#include "LeanRenderer.hpp"
+#include "Meshlets.hpp"
+#include "OcclusionCuller.hpp"
+#include "RenderQueue.hpp"
+#include "Residency.hpp"
+#include "SceneCache.hpp"
+#include "SceneData.hpp"
+#include "SceneParser.hpp"
+#include "TextureStreamer.hpp"
+
+struct RenderSettings {
+    bool occlusionCulling = false;
+    bool meshletCulling = false; // builds meshlets on load (or when first enabled)
+    bool sortedQueue = false;
+    bool leanDrawPath = false;
+    bool indirectDraw = false; // falls back to the paths above without GL 4.3
+    bool gpuCulling = false;   // indirect path only
+    bool textureArrays = false; // indirect path only, batches parts across materials
+    bool streamTextures = false; // applied on the next load, keeps texture arrays off
+    int textureBudgetMB = 512;
+    bool lazyTextures = false; // applied on the next load, textures are decoded once a part using them is visible
+    int textureEvictSeconds = 30; // lazy textures out of view for this long are unloaded
+    // applied on the next load, parts are only decoded and uploaded once they're in view or close to it
+    bool lazyGeometry = false;
+    // above this, lazy textures and lazy geometry least recently in view are evicted
+    int vramBudgetMB = 1024;
+    // reopen unchanged files from the decoded on-disk cache, off with streamed or lazy textures and lazy geometry
+    bool diskCache = true;
+    int diskCacheMB = 4096; // cache files used least recently are removed above this
+    bool hotReload = true; // watch files loaded from now on and re-read the chunks that change on disk
+};
+
+struct RenderStats {
+    unsigned int queried = 0;
+    unsigned int occluded = 0;
+    unsigned int drawn = 0;
+    unsigned int meshlets = 0;
+    unsigned int meshletsVisible = 0;
+    unsigned int queued = 0;
+    unsigned int frustumCulled = 0;
+    double drawsPerSecond = 0; // draw calls per second of CPU time spent submitting
+    bool indirect = false;     // the frame went through the multi-draw indirect path
+    unsigned int indirectDraws = 0;
+    StreamingStats streaming;
+    LazyTextureStats lazy;
+    LazyGeometryStats geometry;
+    ResidencyStats residency;
 };
 
-struct MeshPart {
-    unsigned int vertexBufferID;
-    unsigned int indexBufferID;
-    unsigned int indexOffset;
-    unsigned int indexCount;
-    unsigned int vertexOffset;
-    unsigned int vertexCount;
-    int textureID;
+struct LoadFailure {
+    std::string filename;
+    ParseError error;
 };
 
 class Scene {
   public:
     Scene();
     ~Scene();
-    void load(const std::string& filename);
+    // Adds the files to the scene, they're read and parsed concurrently on the thread pool and uploaded
+    // in order. Files already loaded are skipped. Textures and meshes identical to ones already uploaded
+    // (by any file) are shared. False if any file failed, the others stay loaded
+    bool load(const std::vector<std::string>& filenames, std::vector<LoadFailure>* failures = nullptr);
+    // false if the file isn't loaded
+    bool unload(const std::string& filename);
+    void clear();
+    // applies finished reloads of files that changed on disk and starts new ones, call once per frame
+    void update();
+
+    // in load order
+    std::vector<std::string> files() const;
+    bool empty() const { return m_files.empty(); }
+
+    void render(const Camera& camera);
 
-    void render();
+    RenderSettings& settings() { return m_settings; }
+    const RenderStats& stats() const { return m_stats; }
 
   private:
-    void loadVertices(BinReader& reader, MeshPart& part);
-    void loadIndices(BinReader& reader, MeshPart& part);
-    void genMesh(const MeshPart& part);
-    void readPart(BinReader& reader, MeshPart& part);
-    void loadTextures(BinReader& reader, int count);
-    void cleanup();
+    // a file's range of parts and its textures, by the file's texture indices
+    struct LoadedFile {
+        std::string filename;
+        size_t firstPart = 0;
+        size_t partCount = 0;
+        std::unordered_map<int, Texture> textures;
+        std::unordered_map<int, uint64_t> textureHashes;
+        std::unordered_map<int, unsigned int> lazyTextures; // texture index -> LazyTextures handle
+        std::vector<ChunkSpan> chunks; // as of the last (re)load, empty when not watched
+    };
 
+    // everything a pool task can do for a file without GL
+    struct PreparedFile {
+        std::string filename;
+        std::optional<SceneCache::Key> cacheKey;
+        std::unique_ptr<SceneCache> cache; // set when the file opens from the disk cache
+        SceneData data;
+        std::vector<uint64_t> meshHashes; // per part
+        std::vector<ChunkSpan> chunks;
+        // a reload leaves out what didn't change, see ParseOptions
+        bool texturesRead = true;
+        bool meshesRead = true;
+        bool ok = false;
+        ParseError error;
+    };
+
+    struct PendingReload {
+        std::string filename;
+        std::future<PreparedFile> result;
+        bool again = false; // changed once more while being read
+    };
+
+    static PreparedFile prepare(const std::string& filename, const ParseOptions& options, bool diskCache, bool watch);
+    static PreparedFile prepareReload(const std::string& filename, ParseOptions options, bool diskCache,
+                                      const std::vector<ChunkSpan>& previous);
+    static void hashParts(PreparedFile& prepared);
+    void startReload(const std::string& filename);
+    void applyReload(PreparedFile& prepared);
+    void genMesh(const ScenePart& part, uint64_t hash, LoadedFile& file);
+    // `geometry` is the LazyGeometry handle of a deferred part, whose model has no mesh until it's resident
+    void addPart(Mesh mesh, int texture, bool blended, const BoundingBox& bounds, LoadedFile& file, int geometry = -1);
+    void unloadParts(size_t first, size_t count);
+    void releaseTextures(LoadedFile& file);
+    void resetDerived();
+    void buildMeshlets();
+    void cullMeshlets(Vector3 camPos);
+    void restoreIndices();
+    void buildQueue(Vector3 camPos);
+    void drawPart(size_t idx);
+    bool renderIndirect();
+    void updateDrawRate(double seconds, unsigned int draws);
+    void streamTextures(const Camera& camera);
+    void updateLazyTextures();
+    void updateGeometry();
+    void bindGeometry(size_t part);
+    void updateResidency();
+    void countPinnedBytes();
+    void markShared();
+    bool diskCacheEnabled() const;
+    void loadTextures(SceneData& data, LoadedFile& file);
+    void loadCached(const SceneCache& cache, const std::vector<uint64_t>& meshHashes, LoadedFile& file);
+    void writeCache(const SceneCache::Key& key, const LoadedFile& file);
+
+    std::vector<LoadedFile> m_files;
+    // every file's parts back to back
     std::vector<Model> m_models;
-    // std::unordered_map<unsigned int, Texture> m_textures;
-    std::unordered_map<int, Texture> m_textures;
-    std::unordered_map<unsigned int, std::vector<MeshVertex>> m_vertexBuffers;
-    std::unordered_map<unsigned int, std::vector<unsigned short>> m_indexBuffers;
-    unsigned int m_refCounter;
+    std::vector<BoundingBox> m_bounds;
+    std::vector<bool> m_blended;
+    std::vector<int> m_partTextures; // index into the part's file textures, -1 for untextured parts
+    std::vector<int> m_partGeometry; // LazyGeometry handle, -1 for parts uploaded on load
+
+    RenderSettings m_settings;
+    RenderStats m_stats;
+    OcclusionCuller m_occlusion;
+    std::vector<MeshletPart> m_meshlets;
+    RenderQueue m_queue;
+    LeanRenderer m_lean;
+    IndirectRenderer m_indirect;
+    TextureArrays m_textureArrays;
+    TextureStreamer m_streamer;
+    Residency m_residency; // before what reports to it
+    size_t m_pinnedBytes;  // uploaded outside of m_lazy and m_geometry
+    std::unordered_set<unsigned int> m_pinnedTextures, m_pinnedMeshes; // texture ids, vertex VBOs
+    LazyTextures m_lazy;
+    unsigned long m_lazyGeneration; // the indirect path's batches were built with
+    LazyGeometry m_geometry;
+    unsigned long m_geometryGeneration; // the parts' models were last bound with
+    FileWatcher m_watcher;
+    std::vector<PendingReload> m_reloads;
+    enum class Support {
+        Unknown,
+        Yes,
+        No
+    } m_indirectSupport;
+
+    struct {
+        double windowStart = 0;
+        double seconds = 0;
+        unsigned long draws = 0;
+        double perSecond = 0;
+    } m_drawRate;
 };
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "TextureArrays.hpp"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <unordered_set>
+#include "gl.hpp"
+#include "logger.hpp"
+
+TextureArrays::TextureArrays() : m_white(0) {}
+
+TextureArrays::~TextureArrays() {
+    reset();
+}
+
+void TextureArrays::reset() {
+    for (auto array : m_arrays) {
+        glDeleteTextures(1, &array);
+    }
+    m_arrays.clear();
+    m_slots.clear();
+    m_white = 0;
+}
+
+static void setSampling(int mips) {
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, mips > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, mips - 1);
+}
+
+void TextureArrays::build(const std::vector<Texture>& textures) {
+    reset();
+
+    // format, width, height, mips -> textures
+    std::map<std::tuple<int, int, int, int>, std::vector<Texture>> buckets;
+    std::unordered_set<unsigned int> seen; // deduplicated textures show up under several indices and files
+    for (const auto& tex : textures) {
+        if (!seen.insert(tex.id).second)
+            continue;
+        buckets[{tex.format, tex.width, tex.height, tex.mipmaps}].push_back(tex);
+    }
+
+    for (const auto& [key, members] : buckets) {
+        auto [format, width, height, mips] = key;
+
+        unsigned int internalFormat = 0, glFormat = 0, glType = 0;
+        rlGetGlTextureFormats(format, &internalFormat, &glFormat, &glType);
+
+        unsigned int array;
+        glGenTextures(1, &array);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, mips, internalFormat, width, height, members.size());
+        setSampling(mips);
+
+        for (auto layer = 0u; layer < members.size(); layer++) {
+            for (auto level = 0; level < mips; level++) {
+                glCopyImageSubData(members[layer].id, GL_TEXTURE_2D, level, 0, 0, 0, array, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+                                   std::max(width >> level, 1), std::max(height >> level, 1), 1);
+            }
+            m_slots[members[layer].id] = {array, (int)layer};
+        }
+        m_arrays.push_back(array);
+    }
+
+    const unsigned char white[4] = {255, 255, 255, 255};
+    glGenTextures(1, &m_white);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_white);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    setSampling(1);
+    m_arrays.push_back(m_white);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    logD("TEXARRAYS: Packed {} textures into {} arrays", seen.size(), m_arrays.size());
+}
+
+TextureArrays::Slot TextureArrays::find(unsigned int textureId) const {
+    auto it = m_slots.find(textureId);
+    if (it == m_slots.end())
+        return {m_white, 0};
+    return it->second;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include <raylib.h>
+
+// Packs every loaded texture into GL_TEXTURE_2D_ARRAYs, one array per (format, size, mip count),
+// so parts with different materials can share one draw and pick their texture by layer.
+// Textures are copied GPU-side with glCopyImageSubData, so this needs GL 4.3 like the indirect path.
+class TextureArrays {
+  public:
+    struct Slot {
+        unsigned int array;
+        int layer;
+    };
+
+    TextureArrays();
+    ~TextureArrays();
+
+    void build(const std::vector<Texture>& textures);
+    void reset();
+    bool isBuilt() const { return !m_arrays.empty(); }
+
+    // the slot a texture got copied to, parts without a known texture get a 1x1 white layer
+    Slot find(unsigned int textureId) const;
+    size_t arrayCount() const { return m_arrays.size(); }
+
+  private:
+    std::vector<unsigned int> m_arrays;
+    std::unordered_map<unsigned int, Slot> m_slots;
+    unsigned int m_white;
+};
@@ -0,0 +1,47 @@
+#include "TextureCache.hpp"
+
+TextureCache& TextureCache::shared() {
+    static TextureCache cache;
+    return cache;
+}
+
+std::optional<Texture> TextureCache::acquire(uint64_t hash) {
+    std::lock_guard lock(m_mutex);
+    auto it = m_entries.find(hash);
+    if (it == m_entries.end())
+        return std::nullopt;
+    it->second.refs++;
+    return it->second.texture;
+}
+
+Texture TextureCache::insert(uint64_t hash, const Texture& tex) {
+    std::lock_guard lock(m_mutex);
+    auto [it, inserted] = m_entries.try_emplace(hash, Entry {tex, 1});
+    if (!inserted) {
+        UnloadTexture(tex);
+        it->second.refs++;
+        return it->second.texture;
+    }
+    m_hashes[tex.id] = hash;
+    return tex;
+}
+
+bool TextureCache::release(unsigned int textureId) {
+    std::lock_guard lock(m_mutex);
+    auto hashIt = m_hashes.find(textureId);
+    if (hashIt == m_hashes.end())
+        return false;
+
+    auto it = m_entries.find(hashIt->second);
+    if (--it->second.refs == 0) {
+        UnloadTexture(it->second.texture);
+        m_entries.erase(it);
+        m_hashes.erase(hashIt);
+    }
+    return true;
+}
+
+size_t TextureCache::size() {
+    std::lock_guard lock(m_mutex);
+    return m_entries.size();
+}
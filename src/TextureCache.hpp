@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <raylib.h>
+
+// Process-wide cache of uploaded textures keyed by the hash of their file blob, so the same payload
+// is decoded and uploaded once no matter how many parts, files or scenes use it. Refcounted, the
+// texture is unloaded when the last user releases it
+class TextureCache {
+  public:
+    static TextureCache& shared();
+
+    // adds a reference if the texture is cached
+    std::optional<Texture> acquire(uint64_t hash);
+    // takes ownership of `tex` with one reference. If the hash got cached meanwhile, `tex` is
+    // unloaded and the cached texture is returned instead
+    Texture insert(uint64_t hash, const Texture& tex);
+    // returns false if the texture isn't owned by the cache
+    bool release(unsigned int textureId);
+
+    size_t size();
+
+  private:
+    struct Entry {
+        Texture texture;
+        unsigned int refs;
+    };
+
+    std::unordered_map<uint64_t, Entry> m_entries;
+    std::unordered_map<unsigned int, uint64_t> m_hashes; // GL id -> hash
+    std::mutex m_mutex;
+};
@@ -0,0 +1,235 @@
+#include "TextureStreamer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include "BinReader.hpp"
+#include "Dxt.hpp"
+#include "ThreadPool.hpp"
+#include "gl.hpp"
+#include "logger.hpp"
+
+// keeps a single frame from stalling on uploads
+constexpr size_t maxUploadBytesPerFrame = 8 * 1024 * 1024;
+constexpr unsigned int maxLoadsInFlight = 8;
+
+constexpr size_t ddsHeaderSize = 128;
+
+static int levelDim(int size, int level) {
+    return std::max(size >> level, 1);
+}
+
+TextureStreamer::TextureStreamer() : m_frame(0) {}
+
+TextureStreamer::~TextureStreamer() {
+    reset();
+}
+
+void TextureStreamer::reset() {
+    // textures themselves are owned by the scene, just wait for reads that still reference entries
+    for (auto& entry : m_entries) {
+        if (entry.pending.valid())
+            entry.pending.wait();
+    }
+    m_entries.clear();
+    m_lookup.clear();
+    m_stats = {};
+}
+
+void TextureStreamer::remove(unsigned int textureId) {
+    auto it = m_lookup.find(textureId);
+    if (it == m_lookup.end())
+        return;
+
+    auto& entry = m_entries[it->second];
+    if (entry.pending.valid())
+        entry.pending.wait();
+    m_entries.erase(m_entries.begin() + it->second);
+
+    m_lookup.clear();
+    for (auto i = 0u; i < m_entries.size(); i++) {
+        m_lookup[m_entries[i].texture.id] = i;
+    }
+    m_stats.textures = m_entries.size();
+}
+
+Texture TextureStreamer::add(const std::string& filename, size_t offset, const uint8_t* data, int format, int width, int height,
+                             int mips, int firstLevel) {
+    auto bc3 = format == PIXELFORMAT_COMPRESSED_DXT5_RGBA;
+
+    unsigned int internalFormat = 0, glFormat = 0, glType = 0;
+    rlGetGlTextureFormats(format, &internalFormat, &glFormat, &glType);
+
+    unsigned int id;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D, id);
+    for (auto level = firstLevel; level < mips; level++) {
+        auto size = dxt::getStoredLevelSize(width, height, level, bc3);
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, levelDim(width, level), levelDim(height, level), 0, size, data);
+        data += size;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, firstLevel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mips - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    Texture tex = {id, width, height, mips, format};
+
+    Entry entry;
+    entry.filename = filename;
+    entry.offset = offset;
+    entry.texture = tex;
+    entry.glFormat = internalFormat;
+    entry.bc3 = bc3;
+    entry.minLevel = firstLevel;
+    entry.baseLevel = firstLevel;
+    entry.wantedLevel = firstLevel;
+    entry.lastRequested = 0;
+    entry.pendingLevel = -1;
+    entry.failed = false;
+    m_lookup[id] = m_entries.size();
+    m_entries.push_back(std::move(entry));
+    m_stats.textures = m_entries.size();
+
+    return tex;
+}
+
+void TextureStreamer::request(unsigned int textureId, float pixels) {
+    auto it = m_lookup.find(textureId);
+    if (it == m_lookup.end())
+        return;
+
+    auto& entry = m_entries[it->second];
+    auto size = std::max(entry.texture.width, entry.texture.height);
+    // one texel per pixel is enough, anything finer only adds bandwidth
+    auto level = pixels >= 1.f ? (int)std::floor(std::log2(size / pixels)) : entry.texture.mipmaps - 1;
+    level = std::clamp(level, 0, entry.texture.mipmaps - 1);
+
+    if (entry.lastRequested != m_frame) {
+        entry.lastRequested = m_frame;
+        entry.wantedLevel = level;
+    } else {
+        entry.wantedLevel = std::min(entry.wantedLevel, level);
+    }
+}
+
+void TextureStreamer::setBaseLevel(Entry& entry, int level) {
+    glBindTexture(GL_TEXTURE_2D, entry.texture.id);
+    // dropping levels: respecify them empty so the driver can free the memory
+    for (auto i = entry.baseLevel; i < level; i++) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, i, entry.glFormat, 0, 0, 0, 0, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    entry.baseLevel = level;
+}
+
+size_t TextureStreamer::residentBytes(const Entry& entry) const {
+    const auto& tex = entry.texture;
+    return dxt::getStoredLevelOffset(tex.width, tex.height, tex.mipmaps, entry.bc3) -
+           dxt::getStoredLevelOffset(tex.width, tex.height, entry.baseLevel, entry.bc3);
+}
+
+void TextureStreamer::update(size_t budgetBytes) {
+    m_stats.uploads = 0;
+    m_stats.evictions = 0;
+    m_stats.loading = 0;
+    m_stats.textures = m_entries.size();
+
+    size_t uploaded = 0;
+    unsigned int inFlight = 0;
+
+    // finished reads go to the GPU
+    for (auto& entry : m_entries) {
+        if (!entry.pending.valid())
+            continue;
+        if (uploaded >= maxUploadBytesPerFrame ||
+            entry.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            inFlight++;
+            continue;
+        }
+
+        std::vector<uint8_t> data;
+        try {
+            data = entry.pending.get();
+        } catch (const ReadError& e) {
+            logW("TEXTURES: Streaming from {} failed, keeping mip {}: {}", entry.filename, entry.baseLevel, e.what());
+            entry.failed = true;
+            entry.pendingLevel = -1;
+            continue;
+        }
+        const auto& tex = entry.texture;
+        glBindTexture(GL_TEXTURE_2D, tex.id);
+        auto ptr = data.data();
+        for (auto level = entry.pendingLevel; level < entry.baseLevel; level++) {
+            auto size = dxt::getStoredLevelSize(tex.width, tex.height, level, entry.bc3);
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, entry.glFormat, levelDim(tex.width, level), levelDim(tex.height, level), 0,
+                                   size, ptr);
+            ptr += size;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.pendingLevel);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        entry.baseLevel = entry.pendingLevel;
+        entry.pendingLevel = -1;
+        uploaded += data.size();
+        m_stats.uploads++;
+    }
+
+    size_t total = 0;
+    for (const auto& entry : m_entries) {
+        total += residentBytes(entry);
+    }
+
+    // over budget: drop the top level of whatever was needed least recently, one level at a time. textures used
+    // this frame are left alone so demand can't evict itself and reload every frame
+    while (total > budgetBytes) {
+        Entry* victim = nullptr;
+        for (auto& entry : m_entries) {
+            if (entry.baseLevel >= entry.minLevel || entry.pending.valid() || entry.lastRequested == m_frame)
+                continue;
+            if (!victim || entry.lastRequested < victim->lastRequested ||
+                (entry.lastRequested == victim->lastRequested && entry.baseLevel < victim->baseLevel))
+                victim = &entry;
+        }
+        if (!victim)
+            break;
+
+        auto before = residentBytes(*victim);
+        setBaseLevel(*victim, victim->baseLevel + 1);
+        total -= before - residentBytes(*victim);
+        m_stats.evictions++;
+    }
+
+    // start reads for textures that need more detail than they have, as long as the result still fits
+    for (auto& entry : m_entries) {
+        if (inFlight >= maxLoadsInFlight)
+            break;
+        if (entry.pending.valid() || entry.failed || entry.lastRequested != m_frame || entry.wantedLevel >= entry.baseLevel)
+            continue;
+
+        const auto& tex = entry.texture;
+        auto begin = entry.offset + ddsHeaderSize + dxt::getStoredLevelOffset(tex.width, tex.height, entry.wantedLevel, entry.bc3);
+        auto end = entry.offset + ddsHeaderSize + dxt::getStoredLevelOffset(tex.width, tex.height, entry.baseLevel, entry.bc3);
+        if (total + (end - begin) > budgetBytes)
+            continue;
+        total += end - begin;
+
+        entry.pendingLevel = entry.wantedLevel;
+        entry.pending = ThreadPool::shared().submit([filename = entry.filename, begin, end]() {
+            auto reader = BinReader(filename, Endianness::Little);
+            std::vector<uint8_t> data(end - begin);
+            reader.seek(begin);
+            reader.read(data.data(), data.size());
+            return data;
+        });
+        inFlight++;
+    }
+    m_stats.loading = inFlight;
+
+    m_stats.residentBytes = total;
+
+    m_frame++;
+}
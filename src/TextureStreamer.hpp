@@ -0,0 +1,66 @@
+#pragma once
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <raylib.h>
+
+struct StreamingStats {
+    size_t residentBytes = 0;
+    unsigned int textures = 0;
+    unsigned int loading = 0;
+    unsigned int uploads = 0;   // this frame
+    unsigned int evictions = 0; // this frame
+};
+
+// Mip streaming for DXT textures that carry their own mip chain in the file. Only the low mips are
+// uploaded at load time; the rest stay in the file and are read in on demand (on the thread pool)
+// when visible parts need more texel density, then evicted again when over the VRAM budget.
+class TextureStreamer {
+  public:
+    // largest side of the highest mip uploaded at load time
+    static constexpr int initialSize = 64;
+
+    TextureStreamer();
+    ~TextureStreamer();
+
+    // `offset` is where the DDS blob starts in the file, `data` holds its levels from `firstLevel` on
+    Texture add(const std::string& filename, size_t offset, const uint8_t* data, int format, int width, int height, int mips,
+                int firstLevel);
+    // stops streaming a texture, it stays owned by the caller like with reset()
+    void remove(unsigned int textureId);
+    void reset();
+    bool empty() const { return m_entries.empty(); }
+    bool streams(unsigned int textureId) const { return m_lookup.contains(textureId); }
+
+    // a visible part using `textureId` covers about `pixels` pixels on screen
+    void request(unsigned int textureId, float pixels);
+    // finishes reads, uploads them, starts new ones and evicts down to the budget
+    void update(size_t budgetBytes);
+
+    const StreamingStats& stats() const { return m_stats; }
+
+  private:
+    struct Entry {
+        std::string filename;
+        size_t offset;
+        Texture texture;
+        unsigned int glFormat;
+        bool bc3;
+        int minLevel;    // lowest-resolution level we never evict below
+        int baseLevel;   // highest resolution level resident on the GPU
+        int wantedLevel; // this frame's demand
+        unsigned long lastRequested;
+        int pendingLevel;
+        std::future<std::vector<uint8_t>> pending;
+        bool failed; // a read failed (file gone or shorter), stays at its current level
+    };
+
+    void setBaseLevel(Entry& entry, int level);
+    size_t residentBytes(const Entry& entry) const;
+
+    std::vector<Entry> m_entries;
+    std::unordered_map<unsigned int, size_t> m_lookup; // GL id -> entry
+    unsigned long m_frame;
+    StreamingStats m_stats;
+};
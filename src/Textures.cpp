@@ -0,0 +1,375 @@
+#include "Textures.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+#include "Dxt.hpp"
+#include "ThreadPool.hpp"
+#include "gl.hpp"
+#include "logger.hpp"
+#include "umHalf.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define NUEX_SSE2
+#endif
+
+namespace textures {
+    // texels per parallelFor chunk, keeps small textures on the calling thread
+    constexpr size_t conversionGrain = 16 * 1024;
+
+    // true if every channel of every texel lies within [0, 1]
+    static bool isLDR(const float* src, size_t texels) {
+        std::atomic<bool> ldr = true;
+        ThreadPool::shared().parallelFor(
+            texels,
+            [&](size_t begin, size_t end) {
+#ifdef NUEX_SSE2
+                auto lo = _mm_set1_ps(0.f), hi = _mm_set1_ps(1.f);
+                auto outside = _mm_setzero_ps();
+                for (auto i = begin; i < end; i++) {
+                    auto v = _mm_loadu_ps(src + i * 4);
+                    // NaNs fail both comparisons, so they count as HDR too
+                    outside = _mm_or_ps(outside, _mm_or_ps(_mm_cmpnge_ps(v, lo), _mm_cmpnle_ps(v, hi)));
+                }
+                if (_mm_movemask_ps(outside) != 0)
+                    ldr = false;
+#else
+                for (auto i = begin * 4; i < end * 4; i++) {
+                    if (!(src[i] >= 0.f && src[i] <= 1.f)) {
+                        ldr = false;
+                        return;
+                    }
+                }
+#endif
+            },
+            conversionGrain);
+        return ldr;
+    }
+
+    static void toRGBA8(const float* src, uint8_t* dst, size_t texels) {
+        ThreadPool::shared().parallelFor(
+            texels,
+            [&](size_t begin, size_t end) {
+                auto i = begin;
+#ifdef NUEX_SSE2
+                auto scale = _mm_set1_ps(255.f), rounding = _mm_set1_ps(0.5f);
+                for (; i + 4 <= end; i += 4) {
+                    auto a = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i * 4 + 0), scale), rounding));
+                    auto b = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i * 4 + 4), scale), rounding));
+                    auto c = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i * 4 + 8), scale), rounding));
+                    auto d = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i * 4 + 12), scale), rounding));
+                    auto packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+                    _mm_storeu_si128((__m128i*)(dst + i * 4), packed);
+                }
+#endif
+                for (; i < end; i++) {
+                    for (auto c = 0u; c < 4; c++) {
+                        dst[i * 4 + c] = (uint8_t)(src[i * 4 + c] * 255.f + 0.5f);
+                    }
+                }
+            },
+            conversionGrain);
+    }
+
+    static void toRGBA16F(const float* src, uint16_t* dst, size_t texels) {
+        ThreadPool::shared().parallelFor(
+            texels,
+            [&](size_t begin, size_t end) {
+                auto i = begin;
+#ifdef __F16C__
+                for (; i + 2 <= end; i += 2) {
+                    auto lo = _mm_cvtps_ph(_mm_loadu_ps(src + i * 4 + 0), _MM_FROUND_TO_NEAREST_INT);
+                    auto hi = _mm_cvtps_ph(_mm_loadu_ps(src + i * 4 + 4), _MM_FROUND_TO_NEAREST_INT);
+                    _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_unpacklo_epi64(lo, hi));
+                }
+#endif
+                for (; i < end; i++) {
+                    for (auto c = 0u; c < 4; c++) {
+                        dst[i * 4 + c] = half(src[i * 4 + c]).GetBits();
+                    }
+                }
+            },
+            conversionGrain);
+    }
+
+    Image convertFloatRGBA(const uint8_t* data, int width, int height, int mips) {
+        auto texels = dxt::getMipChainTexels(width, height, mips);
+        auto src = (const float*)data;
+
+        Image img;
+        img.width = width;
+        img.height = height;
+        img.mipmaps = std::max(mips, 1);
+
+        if (isLDR(src, texels)) {
+            img.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+            img.data = MemAlloc(texels * 4);
+            toRGBA8(src, (uint8_t*)img.data, texels);
+        } else {
+            img.format = PIXELFORMAT_UNCOMPRESSED_R16G16B16A16;
+            img.data = MemAlloc(texels * 4 * sizeof(uint16_t));
+            toRGBA16F(src, (uint16_t*)img.data, texels);
+        }
+
+        return img;
+    }
+
+    static void downsampleRGBA8(const uint8_t* src, int srcW, int srcH, uint8_t* dst) {
+        auto dstW = std::max(srcW / 2, 1), dstH = std::max(srcH / 2, 1);
+        ThreadPool::shared().parallelFor(
+            dstH,
+            [&](size_t begin, size_t end) {
+                for (auto y = begin; y < end; y++) {
+                    // a source 1 texel wide/high repeats its only row/column. Other odd sizes are halved rounding
+                    // down, so their last row/column is dropped
+                    auto row0 = src + std::min<size_t>(y * 2, srcH - 1) * srcW * 4;
+                    auto row1 = src + std::min<size_t>(y * 2 + 1, srcH - 1) * srcW * 4;
+                    auto out = dst + y * dstW * 4;
+                    auto x = 0;
+#ifdef NUEX_SSE2
+                    if (srcW >= 2) {
+                        auto zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+                        for (; x + 2 <= dstW; x += 2) {
+                            // 4 source texels from each row -> 2 output texels
+                            auto a = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+                            auto b = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+                            auto lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                            auto hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+                            lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+                            hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+                            auto sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), two), 2);
+                            _mm_storel_epi64((__m128i*)(out + x * 4), _mm_packus_epi16(sum, zero));
+                        }
+                    }
+#endif
+                    for (; x < dstW; x++) {
+                        auto x0 = std::min(x * 2, srcW - 1) * 4, x1 = std::min(x * 2 + 1, srcW - 1) * 4;
+                        for (auto c = 0; c < 4; c++) {
+                            out[x * 4 + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4;
+                        }
+                    }
+                }
+            },
+            8);
+    }
+
+    static void downsampleRGBA16F(const uint16_t* src, int srcW, int srcH, uint16_t* dst) {
+        auto dstW = std::max(srcW / 2, 1), dstH = std::max(srcH / 2, 1);
+        auto toFloat = [](uint16_t bits) {
+            half h;
+            h.GetBits() = bits;
+            return (float)h;
+        };
+        ThreadPool::shared().parallelFor(
+            dstH,
+            [&](size_t begin, size_t end) {
+                for (auto y = begin; y < end; y++) {
+                    auto row0 = src + std::min<size_t>(y * 2, srcH - 1) * srcW * 4;
+                    auto row1 = src + std::min<size_t>(y * 2 + 1, srcH - 1) * srcW * 4;
+                    for (auto x = 0; x < dstW; x++) {
+                        auto x0 = std::min(x * 2, srcW - 1) * 4, x1 = std::min(x * 2 + 1, srcW - 1) * 4;
+                        for (auto c = 0; c < 4; c++) {
+                            auto sum = toFloat(row0[x0 + c]) + toFloat(row0[x1 + c]) + toFloat(row1[x0 + c]) +
+                                       toFloat(row1[x1 + c]);
+                            dst[(y * dstW + x) * 4 + c] = half(sum * 0.25f).GetBits();
+                        }
+                    }
+                }
+            },
+            8);
+    }
+
+    static bool generateUncompressed(Image& img) {
+        auto texelSize = img.format == PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 ? 4 : 8;
+        auto mips = 1;
+        while (std::max(img.width, img.height) >> mips > 0) {
+            mips++;
+        }
+
+        auto data = (uint8_t*)MemAlloc(dxt::getMipChainTexels(img.width, img.height, mips) * texelSize);
+        memcpy(data, img.data, (size_t)img.width * img.height * texelSize);
+
+        auto src = data;
+        auto w = img.width, h = img.height;
+        for (auto level = 1; level < mips; level++) {
+            auto dst = src + (size_t)w * h * texelSize;
+            if (texelSize == 4) {
+                downsampleRGBA8(src, w, h, dst);
+            } else {
+                downsampleRGBA16F((const uint16_t*)src, w, h, (uint16_t*)dst);
+            }
+            src = dst;
+            w = std::max(w / 2, 1);
+            h = std::max(h / 2, 1);
+        }
+
+        MemFree(img.data);
+        img.data = data;
+        img.mipmaps = mips;
+        return true;
+    }
+
+    static bool generateCompressed(Image& img) {
+        auto bc3 = img.format == PIXELFORMAT_COMPRESSED_DXT5_RGBA;
+        auto alpha = img.format == PIXELFORMAT_COMPRESSED_DXT1_RGBA;
+        if (img.width % 4 != 0 || img.height % 4 != 0)
+            return false;
+
+        // raylib sizes compressed levels as whole blocks only when both sides are multiples of 4
+        auto mips = 1;
+        while ((img.width >> mips) % 4 == 0 && (img.height >> mips) % 4 == 0 && (img.width >> mips) > 0 &&
+               (img.height >> mips) > 0) {
+            mips++;
+        }
+        if (mips == 1)
+            return false;
+
+        size_t total = 0;
+        for (auto level = 0; level < mips; level++) {
+            total += dxt::getImageSize(img.width >> level, img.height >> level, bc3);
+        }
+        auto data = (uint8_t*)MemAlloc(total);
+        auto levelSize = dxt::getImageSize(img.width, img.height, bc3);
+        memcpy(data, img.data, levelSize);
+
+        std::vector<uint8_t> rgba((size_t)img.width * img.height * 4);
+        std::vector<uint8_t> next((size_t)img.width * img.height);
+        dxt::decodeImage((const uint8_t*)img.data, img.width, img.height, bc3, rgba.data());
+
+        auto out = data + levelSize;
+        auto w = img.width, h = img.height;
+        for (auto level = 1; level < mips; level++) {
+            downsampleRGBA8(rgba.data(), w, h, next.data());
+            w /= 2;
+            h /= 2;
+            dxt::encodeImage(next.data(), w, h, bc3, alpha, out);
+            out += dxt::getImageSize(w, h, bc3);
+            rgba.swap(next);
+        }
+
+        MemFree(img.data);
+        img.data = data;
+        img.mipmaps = mips;
+        return true;
+    }
+
+    bool generateMipmaps(Image& img) {
+        if (img.mipmaps > 1 || img.data == nullptr)
+            return false;
+
+        switch (img.format) {
+        case PIXELFORMAT_UNCOMPRESSED_R8G8B8A8:
+        case PIXELFORMAT_UNCOMPRESSED_R16G16B16A16:
+            return generateUncompressed(img);
+        case PIXELFORMAT_COMPRESSED_DXT1_RGB:
+        case PIXELFORMAT_COMPRESSED_DXT1_RGBA:
+        case PIXELFORMAT_COMPRESSED_DXT5_RGBA:
+            return generateCompressed(img);
+        default:
+            return false;
+        }
+    }
+
+    Image decode(const TextureBlob& blob) {
+        Image img;
+        if (blob.format == TextureFormat::FloatRGBA) {
+            img = convertFloatRGBA(blob.data.get() + 128, blob.width, blob.height, blob.mips);
+        } else {
+            img = LoadImageFromMemory(".dds", blob.data.get(), blob.size);
+        }
+        if (img.data && img.mipmaps == 1)
+            generateMipmaps(img);
+        return img;
+    }
+
+    Texture2D upload(const Image& img) {
+        auto tex = LoadTextureFromImage(img);
+        if (tex.mipmaps > 1) {
+            // compressed chains may stop before 1x1, keep GL from expecting the missing levels
+            glBindTexture(GL_TEXTURE_2D, tex.id);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, tex.mipmaps - 1);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            SetTextureFilter(tex, TEXTURE_FILTER_TRILINEAR);
+        } else {
+            SetTextureFilter(tex, TEXTURE_FILTER_BILINEAR);
+        }
+        return tex;
+    }
+
+    static bool isBlockCompressed(int format) {
+        return format == PIXELFORMAT_COMPRESSED_DXT1_RGB || format == PIXELFORMAT_COMPRESSED_DXT1_RGBA ||
+               format == PIXELFORMAT_COMPRESSED_DXT5_RGBA;
+    }
+
+    size_t getLevelSize(int format, int width, int height, int level) {
+        auto w = std::max(width >> level, 1), h = std::max(height >> level, 1);
+        if (isBlockCompressed(format))
+            return dxt::getImageSize(w, h, format == PIXELFORMAT_COMPRESSED_DXT5_RGBA);
+        return GetPixelDataSize(w, h, format);
+    }
+
+    size_t getTextureSize(const Texture2D& tex) {
+        size_t total = 0;
+        for (auto level = 0; level < std::max(tex.mipmaps, 1); level++) {
+            total += getLevelSize(tex.format, tex.width, tex.height, level);
+        }
+        return total;
+    }
+
+    std::vector<uint8_t> download(const Texture2D& tex) {
+        if (!isBlockCompressed(tex.format) && tex.format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 &&
+            tex.format != PIXELFORMAT_UNCOMPRESSED_R16G16B16A16)
+            return {};
+
+        size_t total = 0;
+        for (auto level = 0; level < tex.mipmaps; level++) {
+            total += getLevelSize(tex.format, tex.width, tex.height, level);
+        }
+        std::vector<uint8_t> data(total);
+
+        unsigned int internalFormat = 0, glFormat = 0, glType = 0;
+        rlGetGlTextureFormats(tex.format, &internalFormat, &glFormat, &glType);
+
+        glBindTexture(GL_TEXTURE_2D, tex.id);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        auto ptr = data.data();
+        for (auto level = 0; level < tex.mipmaps; level++) {
+            if (isBlockCompressed(tex.format)) {
+                glGetCompressedTexImage(GL_TEXTURE_2D, level, ptr);
+            } else {
+                glGetTexImage(GL_TEXTURE_2D, level, glFormat, glType, ptr);
+            }
+            ptr += getLevelSize(tex.format, tex.width, tex.height, level);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return data;
+    }
+
+    Texture2D uploadLevels(const uint8_t* data, int format, int width, int height, int mips) {
+        unsigned int internalFormat = 0, glFormat = 0, glType = 0;
+        rlGetGlTextureFormats(format, &internalFormat, &glFormat, &glType);
+
+        Texture2D tex = {0, width, height, mips, format};
+        glGenTextures(1, &tex.id);
+        glBindTexture(GL_TEXTURE_2D, tex.id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (auto level = 0; level < mips; level++) {
+            auto w = std::max(width >> level, 1), h = std::max(height >> level, 1);
+            auto size = getLevelSize(format, width, height, level);
+            if (isBlockCompressed(format)) {
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, w, h, 0, size, data);
+            } else {
+                glTexImage2D(GL_TEXTURE_2D, level, internalFormat, w, h, 0, glFormat, glType, data);
+            }
+            data += size;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mips - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        SetTextureFilter(tex, mips > 1 ? TEXTURE_FILTER_TRILINEAR : TEXTURE_FILTER_BILINEAR);
+        return tex;
+    }
+} // namespace textures
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <raylib.h>
+#include "SceneData.hpp"
+
+namespace textures {
+    // Converts D3DFMT_A32B32G32R32F ("D3D 116") texels, mips included, to RGBA8 when every
+    // channel is within [0, 1] or to RGBA16F otherwise. `data` points past the DDS header.
+    // The returned image owns its data (free with UnloadImage)
+    Image convertFloatRGBA(const uint8_t* data, int width, int height, int mips);
+
+    // Builds the full mip chain of a single-level image in place: box filtered on the thread pool for
+    // RGBA8/RGBA16F, and decoded, filtered and re-encoded block by block for DXT1/DXT5. Compressed chains
+    // stop at the last level whose size is still a multiple of the block size. Returns false if the
+    // format isn't handled, the image is left untouched then
+    bool generateMipmaps(Image& img);
+
+    // a whole (not partial) blob to an image with its full mip chain, generated if the file has none.
+    // No GL, safe on any thread. The image is empty (data null) if the blob couldn't be decoded
+    Image decode(const TextureBlob& blob);
+
+    // LoadTextureFromImage plus sampling setup: trilinear when there are mips, bilinear otherwise
+    Texture2D upload(const Image& img);
+
+    // bytes GL stores for one mip level, compressed levels are rounded up to whole blocks
+    size_t getLevelSize(int format, int width, int height, int level);
+    // bytes GL stores for the whole texture, every level included
+    size_t getTextureSize(const Texture2D& tex);
+    // every level of a DXT1/DXT5/RGBA8/RGBA16F texture back to back, empty for other formats
+    std::vector<uint8_t> download(const Texture2D& tex);
+    // uploads the layout download() produces, with the same sampling as upload()
+    Texture2D uploadLevels(const uint8_t* data, int format, int width, int height, int mips);
+} // namespace textures
@@ -1,15 +1,14 @@
 #include "BinReader.hpp"
 
 #include <memory>
+#include "Trace.hpp"
 #include "logger.hpp"
 
 BinReader::BinReader(const std::string& name, Endianness endianness) : m_endianness(endianness) {
     m_stream.open(name, std::ios::binary | std::ios::in);
 
-    if (!m_stream) {
-        logE("Failed to open a BinReader: {}", name);
-        exit(1);
-    }
+    if (!m_stream)
+        throw ReadError(fmt::format("couldn't open {}", name), 0);
 
     m_stream.seekg(0, std::ios::end);
     m_length = m_stream.tellg();
@@ -22,13 +21,21 @@ BinReader::~BinReader() {
 
 void BinReader::read(uint8_t* buffer, size_t len) {
     m_stream.read((char*)buffer, len);
+    if (!m_stream) [[unlikely]]
+        failRead(len);
 }
 
 void BinReader::skip(size_t len) {
     m_stream.ignore(len);
+    // ignore() only hits eof when it ran out of bytes before `len`
+    if (m_stream.eof()) [[unlikely]]
+        failRead(len);
 }
 
 void BinReader::seek(size_t pos) {
+    if (pos > m_length) [[unlikely]]
+        throw ReadError(fmt::format("seek to 0x{:X} past the end (0x{:X})", pos, m_length), pos);
+    m_stream.clear();
     m_stream.seekg(pos);
 }
 
@@ -37,6 +44,7 @@ size_t BinReader::pos() {
 }
 
 size_t BinReader::find(const std::string_view str) {
+    NUEX_TRACE_SCOPE("find");
     auto startPos = pos();
     size_t result = 0;
     constexpr size_t loadAtOnce = 1024 * 1024 * 8; // 8 mb
@@ -51,6 +59,7 @@ size_t BinReader::find(const std::string_view str) {
         if (sizeRead == 0)
             break;
         read(data.get(), sizeRead);
+        NUEX_TRACE_BYTES(sizeRead);
         auto sv = std::string_view((char*)data.get(), sizeRead);
         auto pos = sv.find(str);
         if (pos != std::string_view::npos) {
@@ -60,8 +69,6 @@ size_t BinReader::find(const std::string_view str) {
     }
 
     seek(startPos);
-
-    logE("Couldnt find in binary file", str);
     return 0;
 }
 
@@ -69,6 +76,16 @@ size_t BinReader::length() {
     return m_length;
 }
 
+size_t BinReader::remaining() {
+    return m_length - pos();
+}
+
 void BinReader::setEndianness(Endianness e) {
     m_endianness = e;
 }
+
+void BinReader::failRead(size_t size) {
+    // a short read leaves the stream at the end, having taken gcount() bytes
+    auto offset = m_length - m_stream.gcount();
+    throw ReadError(fmt::format("read of {} bytes at 0x{:X} past the end (0x{:X})", size, offset, m_length), offset);
+}
@@ -1,5 +1,8 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
 #include <fstream>
+#include <stdexcept>
 #include <string>
 #include <string_view>
 
@@ -8,6 +11,16 @@ enum class Endianness {
     Big
 };
 
+// thrown by BinReader when a file can't be opened or a read would go past its end, and by parsers for bad data
+class ReadError : public std::runtime_error {
+  public:
+    ReadError(const std::string& reason, size_t offset) : std::runtime_error(reason), m_offset(offset) {}
+    size_t offset() const { return m_offset; }
+
+  private:
+    size_t m_offset;
+};
+
 class BinReader {
   public:
     BinReader(const std::string& name, Endianness endianness);
@@ -18,6 +31,8 @@ class BinReader {
         auto ptr = (char*)&other;
         auto size = sizeof(other);
         m_stream.read(ptr, size);
+        if (!m_stream) [[unlikely]]
+            failRead(size);
         if (m_endianness == Endianness::Big && size > 1) {
             std::reverse(ptr, ptr + size);
         }
@@ -34,11 +49,16 @@ class BinReader {
     void skip(size_t len);
     void seek(size_t pos);
     size_t pos();
+    // offset of the first match from the start of the file, 0 when there is none
     size_t find(const std::string_view str);
     size_t length();
+    // bytes left after the current position
+    size_t remaining();
     void setEndianness(Endianness e);
 
   private:
+    [[noreturn]] void failRead(size_t size);
+
     std::ifstream m_stream;
     Endianness m_endianness;
     size_t m_length;
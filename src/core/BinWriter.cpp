@@ -0,0 +1,31 @@
+#include "BinWriter.hpp"
+
+#include "umHalf.h"
+
+void BinWriter::putHalf(float value) {
+    half h = value;
+    uint16_t bits;
+    std::memcpy(&bits, &h, 2);
+    put(bits);
+}
+
+void BinWriter::bytes(const void* data, size_t size) {
+    m_data.insert(m_data.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+}
+
+void BinWriter::pad(size_t size) {
+    m_data.resize(m_data.size() + size);
+}
+
+void BinWriter::flush() {
+    if (!m_stream)
+        return;
+    m_stream->write((const char*)m_data.data(), m_data.size());
+    m_written += m_data.size();
+    m_data.clear();
+}
+
+void BinWriter::flushIfAbove(size_t size) {
+    if (m_data.size() >= size)
+        flush();
+}
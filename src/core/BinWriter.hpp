@@ -0,0 +1,45 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <vector>
+#include "BinReader.hpp"
+
+// BinReader's counterpart, buffers what's written in memory. With a stream, flush() moves the buffer to it,
+// so big files can be written without holding them whole
+class BinWriter {
+  public:
+    explicit BinWriter(Endianness endianness) : m_stream(nullptr), m_endianness(endianness), m_written(0) {}
+    BinWriter(std::ostream& stream, Endianness endianness) : m_stream(&stream), m_endianness(endianness), m_written(0) {}
+
+    template <typename T>
+    void put(T value) {
+        auto at = m_data.size();
+        m_data.resize(at + sizeof(T));
+        std::memcpy(m_data.data() + at, &value, sizeof(T));
+        if (m_endianness == Endianness::Big && sizeof(T) > 1)
+            std::reverse(m_data.begin() + at, m_data.end());
+    }
+
+    void putHalf(float value);
+    void bytes(const void* data, size_t size);
+    void pad(size_t size);
+    void setEndianness(Endianness e) { m_endianness = e; }
+
+    // only does something with a stream
+    void flush();
+    // flushes once at least `size` bytes are buffered
+    void flushIfAbove(size_t size);
+
+    // what's buffered and not flushed yet
+    const std::vector<uint8_t>& data() const { return m_data; }
+    // flushed and buffered
+    uint64_t size() const { return m_written + m_data.size(); }
+
+  private:
+    std::ostream* m_stream;
+    Endianness m_endianness;
+    std::vector<uint8_t> m_data;
+    uint64_t m_written;
+};
@@ -0,0 +1,299 @@
+#include "Dxt.hpp"
+
+#include <algorithm>
+#include "ThreadPool.hpp"
+
+namespace dxt {
+    struct RGB {
+        int r, g, b;
+    };
+
+    static RGB unpack565(uint16_t c) {
+        int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+    }
+
+    static uint16_t pack565(int r, int g, int b) {
+        return (uint16_t)(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+    }
+
+    static uint16_t read16(const uint8_t* p) {
+        return p[0] | p[1] << 8;
+    }
+
+    static void write16(uint8_t* p, uint16_t v) {
+        p[0] = v & 0xFF;
+        p[1] = v >> 8;
+    }
+
+    // palette for a color block. BC3 color blocks always use the 4-color mode
+    static void colorPalette(uint16_t c0, uint16_t c1, bool forceFourColor, uint8_t palette[4][4]) {
+        auto a = unpack565(c0), b = unpack565(c1);
+        RGB cols[4] = {a, b};
+        palette[3][3] = 255;
+        if (c0 > c1 || forceFourColor) {
+            cols[2] = {(2 * a.r + b.r) / 3, (2 * a.g + b.g) / 3, (2 * a.b + b.b) / 3};
+            cols[3] = {(a.r + 2 * b.r) / 3, (a.g + 2 * b.g) / 3, (a.b + 2 * b.b) / 3};
+        } else {
+            cols[2] = {(a.r + b.r) / 2, (a.g + b.g) / 2, (a.b + b.b) / 2};
+            cols[3] = {0, 0, 0};
+            palette[3][3] = 0;
+        }
+        for (auto i = 0; i < 4; i++) {
+            palette[i][0] = cols[i].r;
+            palette[i][1] = cols[i].g;
+            palette[i][2] = cols[i].b;
+            if (i < 3)
+                palette[i][3] = 255;
+        }
+    }
+
+    static void decodeColors(const uint8_t* block, uint8_t* rgba, size_t stride, bool forceFourColor) {
+        uint8_t palette[4][4];
+        colorPalette(read16(block), read16(block + 2), forceFourColor, palette);
+        uint32_t bits = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t)block[7] << 24;
+        for (auto y = 0; y < 4; y++) {
+            for (auto x = 0; x < 4; x++) {
+                auto idx = (bits >> ((y * 4 + x) * 2)) & 3;
+                std::copy_n(palette[idx], forceFourColor ? 3 : 4, rgba + y * stride + x * 4);
+            }
+        }
+    }
+
+    void decodeBC1Block(const uint8_t* block, uint8_t* rgba, size_t stride) {
+        decodeColors(block, rgba, stride, false);
+    }
+
+    static void alphaPalette(int a0, int a1, uint8_t palette[8]) {
+        palette[0] = a0;
+        palette[1] = a1;
+        if (a0 > a1) {
+            for (auto i = 1; i < 7; i++) {
+                palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+            }
+        } else {
+            for (auto i = 1; i < 5; i++) {
+                palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+            }
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    void decodeBC3Block(const uint8_t* block, uint8_t* rgba, size_t stride) {
+        uint8_t palette[8];
+        alphaPalette(block[0], block[1], palette);
+        uint64_t bits = 0;
+        for (auto i = 0; i < 6; i++) {
+            bits |= (uint64_t)block[2 + i] << (8 * i);
+        }
+        for (auto y = 0; y < 4; y++) {
+            for (auto x = 0; x < 4; x++) {
+                rgba[y * stride + x * 4 + 3] = palette[(bits >> ((y * 4 + x) * 3)) & 7];
+            }
+        }
+        decodeColors(block + 8, rgba, stride, true);
+    }
+
+    static int distance(const uint8_t* a, const uint8_t* b) {
+        int dr = a[0] - b[0], dg = a[1] - b[1], db = a[2] - b[2];
+        return dr * dr + dg * dg + db * db;
+    }
+
+    static void encodeColors(const uint8_t* rgba, size_t stride, uint8_t* block, bool alpha, bool forceFourColor) {
+        // bounding box of the block's colors, inset a little to spread the error (like stb_dxt's fast path)
+        int min[3] = {255, 255, 255}, max[3] = {0, 0, 0};
+        bool transparent = false;
+        for (auto y = 0; y < 4; y++) {
+            for (auto x = 0; x < 4; x++) {
+                auto px = rgba + y * stride + x * 4;
+                if (alpha && px[3] < 128) {
+                    transparent = true;
+                    continue;
+                }
+                for (auto c = 0; c < 3; c++) {
+                    min[c] = std::min<int>(min[c], px[c]);
+                    max[c] = std::max<int>(max[c], px[c]);
+                }
+            }
+        }
+        if (min[0] > max[0]) {
+            // every texel is transparent
+            std::fill(min, min + 3, 0);
+            std::fill(max, max + 3, 0);
+        }
+        for (auto c = 0; c < 3; c++) {
+            auto inset = (max[c] - min[c]) / 16;
+            min[c] += inset;
+            max[c] -= inset;
+        }
+
+        auto c0 = pack565(max[0], max[1], max[2]);
+        auto c1 = pack565(min[0], min[1], min[2]);
+        bool threeColor = transparent && !forceFourColor;
+        // the endpoint order selects the mode
+        if ((threeColor && c0 > c1) || (!threeColor && c0 < c1))
+            std::swap(c0, c1);
+
+        uint8_t palette[4][4];
+        colorPalette(c0, c1, forceFourColor, palette);
+        write16(block, c0);
+        write16(block + 2, c1);
+
+        uint32_t bits = 0;
+        if (c0 != c1 || threeColor) {
+            for (auto y = 0; y < 4; y++) {
+                for (auto x = 0; x < 4; x++) {
+                    auto px = rgba + y * stride + x * 4;
+                    uint32_t best = 0;
+                    if (threeColor && px[3] < 128) {
+                        best = 3;
+                    } else {
+                        auto bestDist = distance(px, palette[0]);
+                        for (auto i = 1u; i < (threeColor ? 3u : 4u); i++) {
+                            auto dist = distance(px, palette[i]);
+                            if (dist < bestDist) {
+                                bestDist = dist;
+                                best = i;
+                            }
+                        }
+                    }
+                    bits |= best << ((y * 4 + x) * 2);
+                }
+            }
+        }
+        block[4] = bits & 0xFF;
+        block[5] = (bits >> 8) & 0xFF;
+        block[6] = (bits >> 16) & 0xFF;
+        block[7] = bits >> 24;
+    }
+
+    void encodeBC1Block(const uint8_t* rgba, size_t stride, uint8_t* block, bool alpha) {
+        encodeColors(rgba, stride, block, alpha, false);
+    }
+
+    void encodeBC3Block(const uint8_t* rgba, size_t stride, uint8_t* block) {
+        int min = 255, max = 0;
+        for (auto y = 0; y < 4; y++) {
+            for (auto x = 0; x < 4; x++) {
+                int a = rgba[y * stride + x * 4 + 3];
+                min = std::min(min, a);
+                max = std::max(max, a);
+            }
+        }
+
+        block[0] = max;
+        block[1] = min;
+        uint8_t palette[8];
+        alphaPalette(max, min, palette);
+
+        uint64_t bits = 0;
+        if (max != min) {
+            for (auto y = 0; y < 4; y++) {
+                for (auto x = 0; x < 4; x++) {
+                    int a = rgba[y * stride + x * 4 + 3];
+                    uint64_t best = 0;
+                    auto bestDist = 256;
+                    for (auto i = 0u; i < 8; i++) {
+                        auto dist = std::abs(a - palette[i]);
+                        if (dist < bestDist) {
+                            bestDist = dist;
+                            best = i;
+                        }
+                    }
+                    bits |= best << ((y * 4 + x) * 3);
+                }
+            }
+        }
+        for (auto i = 0; i < 6; i++) {
+            block[2 + i] = (bits >> (8 * i)) & 0xFF;
+        }
+
+        encodeColors(rgba, stride, block + 8, false, true);
+    }
+
+    size_t getImageSize(int width, int height, bool bc3) {
+        return (size_t)std::max(1, (width + 3) / 4) * std::max(1, (height + 3) / 4) * (bc3 ? 16 : 8);
+    }
+
+    size_t getStoredLevelSize(int width, int height, int level, bool bc3) {
+        auto w = (size_t)width, h = (size_t)height;
+        if (level > 0) {
+            w = std::max(width >> level, 4);
+            h = std::max(height >> level, 4);
+        }
+        return bc3 ? w * h : w * h / 2;
+    }
+
+    size_t getStoredLevelOffset(int width, int height, int level, bool bc3) {
+        size_t offset = 0;
+        for (auto i = 0; i < level; i++) {
+            offset += getStoredLevelSize(width, height, i, bc3);
+        }
+        return offset;
+    }
+
+    size_t getStoredSize(int width, int height, int mips, bool bc3) {
+        return getStoredLevelOffset(width, height, std::max(mips, 1), bc3);
+    }
+
+    size_t getMipChainTexels(int width, int height, int mips) {
+        size_t texels = 0;
+        for (auto i = 0; i < std::max(mips, 1); i++) {
+            texels += (size_t)std::max(width >> i, 1) * std::max(height >> i, 1);
+        }
+        return texels;
+    }
+
+    int getFirstLevelWithin(int width, int height, int mips, int maxSize) {
+        auto level = 0;
+        while (level < mips - 1 && std::max(std::max(width >> level, 1), std::max(height >> level, 1)) > maxSize) {
+            level++;
+        }
+        return level;
+    }
+
+    void decodeImage(const uint8_t* data, int width, int height, bool bc3, uint8_t* rgba) {
+        auto blocksX = width / 4;
+        auto blockSize = bc3 ? 16 : 8;
+        auto stride = (size_t)width * 4;
+        ThreadPool::shared().parallelFor(
+            height / 4,
+            [&](size_t begin, size_t end) {
+                for (auto by = begin; by < end; by++) {
+                    for (auto bx = 0; bx < blocksX; bx++) {
+                        auto block = data + (by * blocksX + bx) * blockSize;
+                        auto out = rgba + by * 4 * stride + bx * 16;
+                        if (bc3) {
+                            decodeBC3Block(block, out, stride);
+                        } else {
+                            decodeBC1Block(block, out, stride);
+                        }
+                    }
+                }
+            },
+            16);
+    }
+
+    void encodeImage(const uint8_t* rgba, int width, int height, bool bc3, bool alpha, uint8_t* data) {
+        auto blocksX = width / 4;
+        auto blockSize = bc3 ? 16 : 8;
+        auto stride = (size_t)width * 4;
+        ThreadPool::shared().parallelFor(
+            height / 4,
+            [&](size_t begin, size_t end) {
+                for (auto by = begin; by < end; by++) {
+                    for (auto bx = 0; bx < blocksX; bx++) {
+                        auto block = data + (by * blocksX + bx) * blockSize;
+                        auto in = rgba + by * 4 * stride + bx * 16;
+                        if (bc3) {
+                            encodeBC3Block(in, stride, block);
+                        } else {
+                            encodeBC1Block(in, stride, block, alpha);
+                        }
+                    }
+                }
+            },
+            4);
+    }
+} // namespace dxt
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Minimal BC1 (DXT1) / BC3 (DXT5) block codec. Blocks cover 4x4 texels, pixels are RGBA8 rows.
+namespace dxt {
+    size_t getImageSize(int width, int height, bool bc3);
+
+    // size of a mip level the way TT games store it: level 0 as is, smaller levels padded to a whole block
+    size_t getStoredLevelSize(int width, int height, int level, bool bc3);
+    // from the start of the first level's data
+    size_t getStoredLevelOffset(int width, int height, int level, bool bc3);
+    // all levels of one face, header excluded
+    size_t getStoredSize(int width, int height, int mips, bool bc3);
+    // texel count of a full mip chain, every level at least 1x1
+    size_t getMipChainTexels(int width, int height, int mips);
+    // first level whose larger side fits in `maxSize`, the last one at the latest
+    int getFirstLevelWithin(int width, int height, int mips, int maxSize);
+
+    void decodeBC1Block(const uint8_t* block, uint8_t* rgba, size_t stride);
+    void decodeBC3Block(const uint8_t* block, uint8_t* rgba, size_t stride);
+    // `alpha` allows the 3-color mode with transparent texels (DXT1 with 1-bit alpha)
+    void encodeBC1Block(const uint8_t* rgba, size_t stride, uint8_t* block, bool alpha);
+    void encodeBC3Block(const uint8_t* rgba, size_t stride, uint8_t* block);
+
+    // whole images, width and height must be multiples of 4. Run on the thread pool
+    void decodeImage(const uint8_t* data, int width, int height, bool bc3, uint8_t* rgba);
+    void encodeImage(const uint8_t* rgba, int width, int height, bool bc3, bool alpha, uint8_t* data);
+} // namespace dxt
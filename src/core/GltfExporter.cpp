@@ -0,0 +1,342 @@
+#include "GltfExporter.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <unordered_map>
+#include "Dxt.hpp"
+#include "Png.hpp"
+#include "SceneParser.hpp"
+#include "Trace.hpp"
+#include "ThreadPool.hpp"
+#include "logger.hpp"
+
+namespace fs = std::filesystem;
+
+namespace gltf {
+    constexpr uint32_t glbMagic = 0x46546C67; // "glTF"
+    constexpr uint32_t chunkJson = 0x4E4F534A;
+    constexpr uint32_t chunkBin = 0x004E4942;
+    constexpr int targetArrayBuffer = 34962;
+    constexpr int targetElementArrayBuffer = 34963;
+    constexpr int componentUnsignedByte = 5121;
+    constexpr int componentUnsignedShort = 5123;
+    constexpr int componentFloat = 5126;
+
+    static size_t align4(size_t size) {
+        return (size + 3) & ~(size_t)3;
+    }
+
+    static std::string escape(const std::string& str) {
+        std::string out;
+        for (auto c : str) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if ((unsigned char)c < 0x20) {
+                out += fmt::format("\\u{:04x}", (int)c);
+            } else {
+                out += c;
+            }
+        }
+        return out;
+    }
+
+    // a buffer of the source file, rebuilt from the parts that use it
+    struct SharedBuffer {
+        unsigned int id = 0;
+        size_t count = 0; // vertices or indices
+        std::vector<const ScenePart*> parts = {};
+        size_t offset = 0; // in the BIN chunk
+        int firstView = 0;
+    };
+
+    static size_t vertexBufferSize(const SharedBuffer& buffer) {
+        return buffer.count * (12 + 12 + 8 + 4);
+    }
+
+    static size_t indexBufferSize(const SharedBuffer& buffer) {
+        return align4(buffer.count * 2);
+    }
+
+    static void fillVertexBuffer(const SharedBuffer& buffer, uint8_t* out) {
+        auto positions = out;
+        auto normals = positions + buffer.count * 12;
+        auto texcoords = normals + buffer.count * 12;
+        auto colors = texcoords + buffer.count * 8;
+        for (auto part : buffer.parts) {
+            auto first = part->vertexOffset;
+            auto count = part->positions.size() / 3;
+            std::memcpy(positions + first * 12, part->positions.data(), count * 12);
+            std::memcpy(normals + first * 12, part->normals.data(), count * 12);
+            std::memcpy(texcoords + first * 8, part->texcoords.data(), count * 8);
+            std::memcpy(colors + first * 4, part->colors.data(), count * 4);
+        }
+    }
+
+    static void fillIndexBuffer(const SharedBuffer& buffer, uint8_t* out) {
+        for (auto part : buffer.parts) {
+            std::memcpy(out + part->indexOffset * 2, part->indices.data(), part->indices.size() * 2);
+        }
+    }
+
+    static bool isCompressed(TextureFormat format) {
+        return format == TextureFormat::DXT1 || format == TextureFormat::DXT1Alpha || format == TextureFormat::DXT5;
+    }
+
+    // level 0 as RGBA8, empty if the texture can't be converted
+    static std::vector<uint8_t> decodeTexture(const TextureBlob& blob) {
+        std::vector<uint8_t> rgba;
+        auto texels = (size_t)blob.width * blob.height;
+        auto data = blob.data.get() + 128;
+        if (isCompressed(blob.format) && blob.width % 4 == 0 && blob.height % 4 == 0) {
+            rgba.resize(texels * 4);
+            dxt::decodeImage(data, blob.width, blob.height, blob.format == TextureFormat::DXT5, rgba.data());
+        } else if (blob.format == TextureFormat::FloatRGBA) {
+            rgba.resize(texels * 4);
+            for (size_t i = 0; i < texels * 4; i++) {
+                float v;
+                std::memcpy(&v, data + i * 4, 4);
+                rgba[i] = (uint8_t)(std::clamp(v, 0.f, 1.f) * 255.f + 0.5f);
+            }
+        }
+        return rgba;
+    }
+
+    bool exportScene(const SceneData& data, const std::string& path, const GltfOptions& options) {
+        NUEX_TRACE_SCOPE("gltf::exportScene");
+        auto outPath = fs::path(path);
+        auto stem = outPath.stem().string();
+
+        // group parts by the buffers they were cut from
+        std::map<unsigned int, SharedBuffer> vertexBuffers, indexBuffers;
+        std::vector<const ScenePart*> parts;
+        for (const auto& part : data.parts) {
+            if (part.positions.empty() || part.indices.empty())
+                continue;
+            parts.push_back(&part);
+
+            auto& vb = vertexBuffers.try_emplace(part.vertexBuffer, SharedBuffer {.id = part.vertexBuffer}).first->second;
+            vb.count = std::max(vb.count, part.vertexOffset + part.positions.size() / 3);
+            vb.parts.push_back(&part);
+
+            auto& ib = indexBuffers.try_emplace(part.indexBuffer, SharedBuffer {.id = part.indexBuffer}).first->second;
+            ib.count = std::max(ib.count, part.indexOffset + part.indices.size());
+            ib.parts.push_back(&part);
+        }
+
+        // textures in use, one file per distinct payload
+        std::unordered_map<uint64_t, int> imageOfHash;
+        std::vector<int> imageOfTexture(data.textures.size(), -1);
+        std::vector<const TextureBlob*> images;
+        for (const auto* part : parts) {
+            if (part->texture < 0 || imageOfTexture[part->texture] >= 0)
+                continue;
+            const auto& blob = data.textures[part->texture];
+            if (blob.format == TextureFormat::Unknown || blob.partial)
+                continue;
+            auto [it, inserted] = imageOfHash.try_emplace(blob.hash, (int)images.size());
+            if (inserted)
+                images.push_back(&blob);
+            imageOfTexture[part->texture] = it->second;
+        }
+
+        std::vector<std::string> imageUris(images.size());
+        std::vector<bool> imageIsPng(images.size(), false);
+        ThreadPool::shared().parallelFor(images.size(), [&](size_t begin, size_t end) {
+            for (auto i = begin; i < end; i++) {
+                const auto& blob = *images[i];
+                auto name = fmt::format("{}_{:016x}", stem, blob.hash);
+                if (options.pngTextures) {
+                    auto rgba = decodeTexture(blob);
+                    if (!rgba.empty() && png::write((outPath.parent_path() / (name + ".png")).string(), rgba.data(), blob.width,
+                                                    blob.height)) {
+                        imageUris[i] = name + ".png";
+                        imageIsPng[i] = true;
+                        continue;
+                    }
+                }
+                std::ofstream out(outPath.parent_path() / (name + ".dds"), std::ios::binary | std::ios::trunc);
+                out.write((const char*)blob.data.get(), blob.size);
+                imageUris[i] = name + ".dds";
+            }
+        });
+        auto usesDds = std::find(imageIsPng.begin(), imageIsPng.end(), false) != imageIsPng.end();
+
+        // BIN layout: every vertex buffer as four tightly packed streams, then the index buffers
+        std::string views, accessors;
+        auto viewCount = 0, accessorCount = 0;
+        size_t binSize = 0;
+        // every part cut from a buffer gets its own accessors on the buffer's views, so vertex views need their stride
+        auto addView = [&](size_t offset, size_t length, int target, int stride) {
+            auto byteStride = stride ? fmt::format(",\"byteStride\":{}", stride) : "";
+            views += fmt::format("{}{{\"buffer\":0,\"byteOffset\":{},\"byteLength\":{}{},\"target\":{}}}", viewCount ? "," : "",
+                                 offset, length, byteStride, target);
+            return viewCount++;
+        };
+        for (auto& [id, buffer] : vertexBuffers) {
+            buffer.offset = binSize;
+            buffer.firstView = addView(binSize, buffer.count * 12, targetArrayBuffer, 12);
+            addView(binSize + buffer.count * 12, buffer.count * 12, targetArrayBuffer, 12);
+            addView(binSize + buffer.count * 24, buffer.count * 8, targetArrayBuffer, 8);
+            addView(binSize + buffer.count * 32, buffer.count * 4, targetArrayBuffer, 4);
+            binSize += vertexBufferSize(buffer);
+        }
+        for (auto& [id, buffer] : indexBuffers) {
+            buffer.offset = binSize;
+            buffer.firstView = addView(binSize, buffer.count * 2, targetElementArrayBuffer, 0);
+            binSize += indexBufferSize(buffer);
+        }
+
+        auto addAccessor = [&](int view, size_t offset, int component, size_t count, const char* type, const std::string& extra) {
+            accessors += fmt::format("{}{{\"bufferView\":{},\"byteOffset\":{},\"componentType\":{},\"count\":{},\"type\":\"{}\"{}}}",
+                                     accessorCount ? "," : "", view, offset, component, count, type, extra);
+            return accessorCount++;
+        };
+
+        // a material per (image, blended) pair
+        std::map<std::pair<int, bool>, int> materialIds;
+        std::string materials;
+        auto getMaterial = [&](int image, bool blended) {
+            auto [it, inserted] = materialIds.try_emplace({image, blended}, (int)materialIds.size());
+            if (inserted) {
+                auto texture = image >= 0 ? fmt::format("\"baseColorTexture\":{{\"index\":{}}},", image) : "";
+                materials += fmt::format("{}{{\"pbrMetallicRoughness\":{{{}\"metallicFactor\":0,\"roughnessFactor\":1}},"
+                                         "\"alphaMode\":\"{}\",\"doubleSided\":true}}",
+                                         it->second ? "," : "", texture, blended ? "BLEND" : "OPAQUE");
+            }
+            return it->second;
+        };
+
+        std::string primitives;
+        for (auto i = 0u; i < parts.size(); i++) {
+            const auto& part = *parts[i];
+            const auto& vb = vertexBuffers[part.vertexBuffer];
+            const auto& ib = indexBuffers[part.indexBuffer];
+            auto count = part.positions.size() / 3;
+            auto first = part.vertexOffset;
+
+            auto bounds = fmt::format(",\"min\":[{},{},{}],\"max\":[{},{},{}]", part.boundsMin.x, part.boundsMin.y, part.boundsMin.z,
+                                      part.boundsMax.x, part.boundsMax.y, part.boundsMax.z);
+            auto position = addAccessor(vb.firstView, first * 12, componentFloat, count, "VEC3", bounds);
+            auto normal = addAccessor(vb.firstView + 1, first * 12, componentFloat, count, "VEC3", "");
+            auto texcoord = addAccessor(vb.firstView + 2, first * 8, componentFloat, count, "VEC2", "");
+            auto color = addAccessor(vb.firstView + 3, first * 4, componentUnsignedByte, count, "VEC4", ",\"normalized\":true");
+            auto indices =
+                addAccessor(ib.firstView, part.indexOffset * 2, componentUnsignedShort, part.indices.size(), "SCALAR", "");
+
+            auto image = part.texture >= 0 ? imageOfTexture[part.texture] : -1;
+            primitives += fmt::format("{}{{\"attributes\":{{\"POSITION\":{},\"NORMAL\":{},\"TEXCOORD_0\":{},\"COLOR_0\":{}}},"
+                                      "\"indices\":{},\"material\":{},\"mode\":4}}",
+                                      i ? "," : "", position, normal, texcoord, color, indices, getMaterial(image, part.blended));
+        }
+
+        std::string textures, imagesJson;
+        for (auto i = 0u; i < images.size(); i++) {
+            auto sep = i ? "," : "";
+            if (imageIsPng[i]) {
+                textures += fmt::format("{}{{\"sampler\":0,\"source\":{}}}", sep, i);
+                imagesJson += fmt::format("{}{{\"uri\":\"{}\",\"mimeType\":\"image/png\"}}", sep, escape(imageUris[i]));
+            } else {
+                textures += fmt::format("{}{{\"sampler\":0,\"extensions\":{{\"MSFT_texture_dds\":{{\"source\":{}}}}}}}", sep, i);
+                imagesJson += fmt::format("{}{{\"uri\":\"{}\",\"mimeType\":\"image/vnd-ms.dds\"}}", sep, escape(imageUris[i]));
+            }
+        }
+
+        std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"NuExplorer\"}";
+        // DDS textures have no fallback source, loaders without the extension can't show them
+        if (usesDds)
+            json += ",\"extensionsUsed\":[\"MSFT_texture_dds\"],\"extensionsRequired\":[\"MSFT_texture_dds\"]";
+        json += ",\"scene\":0,\"scenes\":[{\"nodes\":[0]}]";
+        if (parts.empty()) {
+            json += fmt::format(",\"nodes\":[{{\"name\":\"{}\"}}]", escape(stem));
+        } else {
+            json += fmt::format(",\"nodes\":[{{\"name\":\"{}\",\"mesh\":0}}]", escape(stem));
+            json += fmt::format(",\"meshes\":[{{\"primitives\":[{}]}}]", primitives);
+            json += fmt::format(",\"materials\":[{}]", materials);
+        }
+        if (!images.empty()) {
+            json += ",\"samplers\":[{\"magFilter\":9729,\"minFilter\":9987}]";
+            json += fmt::format(",\"textures\":[{}],\"images\":[{}]", textures, imagesJson);
+        }
+        if (binSize > 0) {
+            json += fmt::format(",\"buffers\":[{{\"byteLength\":{}}}]", binSize);
+            json += fmt::format(",\"bufferViews\":[{}],\"accessors\":[{}]", views, accessors);
+        }
+        json += "}";
+        json.resize(align4(json.size()), ' ');
+
+        std::ofstream out(outPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            logE("GLTF: Couldn't open {} for writing", path);
+            return false;
+        }
+
+        auto putU32 = [&](uint32_t v) { out.write((const char*)&v, 4); };
+        auto total = 12 + 8 + json.size() + (binSize > 0 ? 8 + binSize : 0);
+        putU32(glbMagic);
+        putU32(2);
+        putU32(total);
+        putU32(json.size());
+        putU32(chunkJson);
+        out.write(json.data(), json.size());
+
+        if (binSize > 0) {
+            putU32(binSize);
+            putU32(chunkBin);
+
+            // buffers are rebuilt a window at a time in parallel and written in order
+            std::vector<const SharedBuffer*> order;
+            for (const auto& [id, buffer] : vertexBuffers) {
+                order.push_back(&buffer);
+            }
+            auto indexStart = order.size();
+            for (const auto& [id, buffer] : indexBuffers) {
+                order.push_back(&buffer);
+            }
+
+            auto window = (size_t)ThreadPool::shared().size() + 1;
+            std::vector<std::vector<uint8_t>> staged(window);
+            for (size_t base = 0; base < order.size(); base += window) {
+                auto count = std::min(window, order.size() - base);
+                ThreadPool::shared().parallelFor(count, [&](size_t begin, size_t end) {
+                    for (auto i = begin; i < end; i++) {
+                        const auto& buffer = *order[base + i];
+                        auto isIndex = base + i >= indexStart;
+                        staged[i].assign(isIndex ? indexBufferSize(buffer) : vertexBufferSize(buffer), 0);
+                        if (isIndex) {
+                            fillIndexBuffer(buffer, staged[i].data());
+                        } else {
+                            fillVertexBuffer(buffer, staged[i].data());
+                        }
+                    }
+                });
+                for (size_t i = 0; i < count; i++) {
+                    out.write((const char*)staged[i].data(), staged[i].size());
+                }
+            }
+        }
+
+        out.close();
+        if (!out) {
+            logE("GLTF: Failed writing {}", path);
+            return false;
+        }
+
+        logD("GLTF: Wrote {} ({} primitives, {} vertex and {} index buffers, {} images)", path, parts.size(), vertexBuffers.size(),
+             indexBuffers.size(), images.size());
+        return true;
+    }
+
+    bool exportFile(const std::string& source, const std::string& path, const GltfOptions& options) {
+        SceneData data;
+        ParseError error;
+        if (!SceneParser().parse(source, data, &error)) {
+            logE("GLTF: Couldn't parse {}: {}", source, error.message());
+            return false;
+        }
+        return exportScene(data, path, options);
+    }
+} // namespace gltf
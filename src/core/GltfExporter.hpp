@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include "SceneData.hpp"
+
+struct GltfOptions {
+    // decode textures to PNG instead of referencing the DDS files through MSFT_texture_dds
+    bool pngTextures = false;
+};
+
+namespace gltf {
+    // Writes a .glb with one mesh, a primitive per part. The file's shared vertex/index buffers become shared
+    // buffer views, textures are written next to `path` (deduplicated by content). The binary chunk is
+    // produced and written a few buffers at a time, so memory stays around the size of the scene itself
+    bool exportScene(const SceneData& data, const std::string& path, const GltfOptions& options = {});
+    // parses `source` first
+    bool exportFile(const std::string& source, const std::string& path, const GltfOptions& options = {});
+} // namespace gltf
@@ -0,0 +1,86 @@
+#include "Hash.hpp"
+
+#include <cstring>
+
+namespace hash {
+    constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr uint64_t prime3 = 0x165667B19E3779F9ull;
+    constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+    constexpr uint64_t prime5 = 0x27D4EB2F165667C5ull;
+
+    static uint64_t rotl(uint64_t x, int r) {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    // files are little endian on every platform we build for
+    static uint64_t read64(const uint8_t* p) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        return v;
+    }
+
+    static uint32_t read32(const uint8_t* p) {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+
+    static uint64_t round(uint64_t acc, uint64_t input) {
+        acc += input * prime2;
+        acc = rotl(acc, 31);
+        return acc * prime1;
+    }
+
+    static uint64_t mergeRound(uint64_t acc, uint64_t val) {
+        acc ^= round(0, val);
+        return acc * prime1 + prime4;
+    }
+
+    uint64_t xxh64(const void* data, size_t size, uint64_t seed) {
+        auto p = (const uint8_t*)data;
+        auto end = p + size;
+        uint64_t h;
+
+        if (size >= 32) {
+            uint64_t v[4] = {seed + prime1 + prime2, seed + prime2, seed, seed - prime1};
+            auto limit = end - 32;
+            do {
+                for (auto lane = 0; lane < 4; lane++) {
+                    v[lane] = round(v[lane], read64(p + lane * 8));
+                }
+                p += 32;
+            } while (p <= limit);
+
+            h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+            for (auto lane = 0; lane < 4; lane++) {
+                h = mergeRound(h, v[lane]);
+            }
+        } else {
+            h = seed + prime5;
+        }
+
+        h += size;
+
+        for (; p + 8 <= end; p += 8) {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * prime1 + prime4;
+        }
+        if (p + 4 <= end) {
+            h ^= (uint64_t)read32(p) * prime1;
+            h = rotl(h, 23) * prime2 + prime3;
+            p += 4;
+        }
+        for (; p < end; p++) {
+            h ^= *p * prime5;
+            h = rotl(h, 11) * prime1;
+        }
+
+        h ^= h >> 33;
+        h *= prime2;
+        h ^= h >> 29;
+        h *= prime3;
+        h ^= h >> 32;
+        return h;
+    }
+} // namespace hash
@@ -0,0 +1,9 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace hash {
+    // XXH64. Four independent 64-bit lanes per 32-byte stripe, which keeps the multipliers busy and
+    // lets the compiler vectorize the main loop
+    uint64_t xxh64(const void* data, size_t size, uint64_t seed = 0);
+} // namespace hash
@@ -0,0 +1,101 @@
+#include "Png.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <vector>
+
+namespace png {
+    static const std::array<uint32_t, 256>& getCrcTable() {
+        static const auto table = []() {
+            std::array<uint32_t, 256> t;
+            for (uint32_t i = 0; i < 256; i++) {
+                auto c = i;
+                for (auto k = 0; k < 8; k++) {
+                    c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                t[i] = c;
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size) {
+        const auto& table = getCrcTable();
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++) {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    static void putU32(std::vector<uint8_t>& out, uint32_t v) {
+        out.push_back(v >> 24);
+        out.push_back(v >> 16);
+        out.push_back(v >> 8);
+        out.push_back(v);
+    }
+
+    static void writeChunk(std::ofstream& out, const char* type, const std::vector<uint8_t>& data) {
+        std::vector<uint8_t> head;
+        putU32(head, data.size());
+        head.insert(head.end(), type, type + 4);
+        auto crc = crc32(0, head.data() + 4, 4);
+        crc = crc32(crc, data.data(), data.size());
+        std::vector<uint8_t> tail;
+        putU32(tail, crc);
+
+        out.write((const char*)head.data(), head.size());
+        out.write((const char*)data.data(), data.size());
+        out.write((const char*)tail.data(), tail.size());
+    }
+
+    bool write(const std::string& path, const uint8_t* rgba, int width, int height) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        out.write((const char*)signature, sizeof(signature));
+
+        std::vector<uint8_t> ihdr;
+        putU32(ihdr, width);
+        putU32(ihdr, height);
+        ihdr.insert(ihdr.end(), {8, 6, 0, 0, 0}); // 8 bit RGBA, deflate, no filter, no interlace
+        writeChunk(out, "IHDR", ihdr);
+
+        // every row gets filter type 0
+        auto rowSize = (size_t)width * 4 + 1;
+        std::vector<uint8_t> raw(rowSize * height);
+        for (auto y = 0; y < height; y++) {
+            raw[y * rowSize] = 0;
+            std::copy_n(rgba + (size_t)y * width * 4, width * 4, raw.begin() + y * rowSize + 1);
+        }
+
+        std::vector<uint8_t> idat = {0x78, 0x01};
+        uint32_t a = 1, b = 0; // adler32
+        for (size_t pos = 0; pos < raw.size() || pos == 0;) {
+            auto len = std::min<size_t>(raw.size() - pos, 65535);
+            auto last = pos + len == raw.size();
+            idat.push_back(last ? 1 : 0);
+            idat.push_back(len & 0xFF);
+            idat.push_back(len >> 8);
+            idat.push_back(~len & 0xFF);
+            idat.push_back((~len >> 8) & 0xFF);
+            for (size_t i = pos; i < pos + len; i++) {
+                a = (a + raw[i]) % 65521;
+                b = (b + a) % 65521;
+            }
+            idat.insert(idat.end(), raw.begin() + pos, raw.begin() + pos + len);
+            pos += len;
+            if (last)
+                break;
+        }
+        putU32(idat, (b << 16) | a);
+        writeChunk(out, "IDAT", idat);
+        writeChunk(out, "IEND", {});
+
+        return (bool)out;
+    }
+} // namespace png
@@ -0,0 +1,9 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace png {
+    // RGBA8, rows top to bottom. Deflate "stored" blocks only: big files, but no zlib dependency and
+    // nothing to spend time on
+    bool write(const std::string& path, const uint8_t* rgba, int width, int height);
+} // namespace png
@@ -0,0 +1,277 @@
+#include "SceneCache.hpp"
+
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <tuple>
+#include <unordered_map>
+#include <fmt/format.h>
+#include "Hash.hpp"
+#include "SceneParser.hpp"
+#include "logger.hpp"
+
+namespace fs = std::filesystem;
+
+constexpr char cacheMagic[8] = {'N', 'U', 'E', 'X', 'C', 'A', 'C', 'H'};
+constexpr uint32_t cacheVersion = 2;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t partCount;
+    uint32_t textureCount;
+    uint32_t pathLength;
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint64_t sourceHash;
+    uint64_t path;
+    uint64_t parts;
+    uint64_t textures;
+};
+
+static fs::path getCacheDir() {
+#ifdef _WIN32
+    if (auto dir = std::getenv("LOCALAPPDATA"))
+        return fs::path(dir) / "NuExplorer" / "cache";
+#else
+    if (auto dir = std::getenv("XDG_CACHE_HOME"))
+        return fs::path(dir) / "NuExplorer";
+    if (auto home = std::getenv("HOME"))
+        return fs::path(home) / ".cache" / "NuExplorer";
+#endif
+    return fs::temp_directory_path() / "NuExplorer";
+}
+
+std::optional<SceneCache::Key> SceneCache::makeKey(const std::string& filename, const std::vector<ChunkSpan>& chunks) {
+    std::error_code ec;
+    auto path = fs::absolute(filename, ec);
+    if (ec)
+        return std::nullopt;
+    auto mtime = fs::last_write_time(path, ec);
+    if (ec)
+        return std::nullopt;
+
+    MappedFile file(path.string());
+    if (!file.isOpen())
+        return std::nullopt;
+    // written to since it was indexed
+    if (!chunks.empty() && chunks.back().offset + chunks.back().size != file.size())
+        return std::nullopt;
+
+    // the chunks reach the end of the file, so with the bytes before them everything is covered
+    std::vector<uint64_t> hashes = {hash::xxh64(file.data(), chunks.empty() ? file.size() : chunks.front().offset)};
+    for (const auto& chunk : chunks) {
+        hashes.push_back(chunk.offset);
+        hashes.push_back(chunk.hash);
+    }
+    return Key {path.string(), file.size(), (int64_t)mtime.time_since_epoch().count(),
+                hash::xxh64(hashes.data(), hashes.size() * sizeof(uint64_t))};
+}
+
+std::string SceneCache::getCachePath(const Key& key) {
+    auto name = fmt::format("{:016x}.nxc", hash::xxh64(key.path.data(), key.path.size()));
+    return (getCacheDir() / name).string();
+}
+
+bool SceneCache::open(const Key& key) {
+    close();
+
+    auto path = getCachePath(key);
+    m_file = MappedFile(path);
+    if (!m_file.isOpen())
+        return false;
+
+    auto fail = [this](const char* reason) {
+        logD("CACHE: Ignoring cache file: {}", reason);
+        close();
+        return false;
+    };
+
+    if (m_file.size() < sizeof(CacheHeader))
+        return fail("truncated header");
+    CacheHeader header;
+    std::memcpy(&header, m_file.data(), sizeof(header));
+    if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion)
+        return fail("different format version");
+    if (header.sourceSize != key.size || header.sourceMtime != key.mtime || header.sourceHash != key.hash)
+        return fail("source file changed");
+
+    auto inBounds = [&](uint64_t offset, uint64_t size) { return offset <= m_file.size() && size <= m_file.size() - offset; };
+    if (!inBounds(header.path, header.pathLength) || !inBounds(header.parts, (uint64_t)header.partCount * sizeof(Part)) ||
+        !inBounds(header.textures, (uint64_t)header.textureCount * sizeof(Texture)))
+        return fail("truncated tables");
+    if (std::string_view((const char*)at(header.path), header.pathLength) != key.path)
+        return fail("path hash collision");
+
+    m_parts.resize(header.partCount);
+    std::memcpy(m_parts.data(), at(header.parts), m_parts.size() * sizeof(Part));
+    m_textures.resize(header.textureCount);
+    std::memcpy(m_textures.data(), at(header.textures), m_textures.size() * sizeof(Texture));
+
+    for (const auto& part : m_parts) {
+        if (!inBounds(part.vertices, part.vertexCount * 12ull) || !inBounds(part.normals, part.vertexCount * 12ull) ||
+            !inBounds(part.texcoords, part.vertexCount * 8ull) || !inBounds(part.colors, part.vertexCount * 4ull) ||
+            !inBounds(part.indices, part.indexCount * 2ull))
+            return fail("truncated part data");
+    }
+    for (const auto& texture : m_textures) {
+        if (!inBounds(texture.data, texture.size))
+            return fail("truncated texture data");
+    }
+
+    // the modification time doubles as the last use, trim() goes by it
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+void SceneCache::trim(uint64_t maxBytes, const std::string& keep) {
+    struct Entry {
+        fs::path path;
+        uint64_t size;
+        fs::file_time_type used;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code ec;
+    for (auto it = fs::directory_iterator(getCacheDir(), ec); !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        if (it->path().extension() != ".nxc")
+            continue;
+        Entry entry = {it->path(), it->file_size(ec), it->last_write_time(ec)};
+        if (ec)
+            continue;
+        total += entry.size;
+        if (entry.path != keep)
+            entries.push_back(entry);
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.used < b.used; });
+    for (const auto& entry : entries) {
+        if (total <= maxBytes)
+            break;
+        if (fs::remove(entry.path, ec)) {
+            total -= entry.size;
+            logD("CACHE: Removed {} ({} MB), the cache is over its size limit", entry.path.string(), entry.size / (1024 * 1024));
+        }
+    }
+}
+
+void SceneCache::close() {
+    m_file.close();
+    m_parts.clear();
+    m_textures.clear();
+}
+
+void SceneCache::Writer::addPart(const Part& part, const float* vertices, const float* normals, const float* texcoords,
+                                 const uint8_t* colors, const uint16_t* indices) {
+    m_parts.push_back({part, vertices, normals, texcoords, colors, indices});
+}
+
+void SceneCache::Writer::addTexture(const Texture& texture, std::vector<uint8_t> data) {
+    m_textures.emplace_back(texture, std::move(data));
+}
+
+bool SceneCache::Writer::write(const Key& key, uint64_t maxCacheBytes) {
+    auto path = fs::path(getCachePath(key));
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+
+    // written next to the real one and renamed, a crash never leaves a half-written cache behind
+    auto tempPath = path;
+    tempPath += ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        logW("CACHE: Couldn't write {}", tempPath.string());
+        return false;
+    }
+
+    uint64_t offset = 0;
+    auto put = [&](const void* data, size_t size) {
+        out.write((const char*)data, size);
+        offset += size;
+    };
+    auto align = [&]() {
+        const char zeros[16] = {};
+        put(zeros, (16 - offset % 16) % 16);
+    };
+
+    CacheHeader header = {};
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.partCount = m_parts.size();
+    header.textureCount = m_textures.size();
+    header.pathLength = key.path.size();
+    header.sourceSize = key.size;
+    header.sourceMtime = key.mtime;
+    header.sourceHash = key.hash;
+    put(&header, sizeof(header)); // patched below once the offsets are known
+
+    align();
+    header.path = offset;
+    put(key.path.data(), key.path.size());
+
+    for (auto& [part, vertices, normals, texcoords, colors, indices] : m_parts) {
+        align();
+        part.vertices = offset;
+        put(vertices, part.vertexCount * 12ull);
+        align();
+        part.normals = offset;
+        put(normals, part.vertexCount * 12ull);
+        align();
+        part.texcoords = offset;
+        put(texcoords, part.vertexCount * 8ull);
+        align();
+        part.colors = offset;
+        put(colors, part.vertexCount * 4ull);
+        align();
+        part.indices = offset;
+        put(indices, part.indexCount * 2ull);
+    }
+    std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> payloads; // hash -> offset, size
+    for (auto& [texture, data] : m_textures) {
+        if (data.empty()) {
+            auto it = payloads.find(texture.hash);
+            if (it != payloads.end())
+                std::tie(texture.data, texture.size) = it->second;
+            continue;
+        }
+        align();
+        texture.data = offset;
+        texture.size = data.size();
+        put(data.data(), data.size());
+        payloads[texture.hash] = {texture.data, texture.size};
+    }
+
+    align();
+    header.parts = offset;
+    for (const auto& pending : m_parts) {
+        put(&pending.part, sizeof(Part));
+    }
+    header.textures = offset;
+    for (const auto& [texture, data] : m_textures) {
+        put(&texture, sizeof(Texture));
+    }
+
+    out.seekp(0);
+    out.write((const char*)&header, sizeof(header));
+    out.close();
+    if (!out) {
+        logW("CACHE: Couldn't write {}", tempPath.string());
+        fs::remove(tempPath, ec);
+        return false;
+    }
+
+    fs::rename(tempPath, path, ec);
+    if (ec) {
+        logW("CACHE: Couldn't move the cache into place: {}", ec.message());
+        fs::remove(tempPath, ec);
+        return false;
+    }
+
+    logD("CACHE: Wrote {} parts and {} textures ({} MB) to {}", m_parts.size(), m_textures.size(), offset / (1024 * 1024),
+         path.string());
+    trim(maxCacheBytes, path.string());
+    return true;
+}
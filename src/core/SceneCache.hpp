@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "MappedFile.hpp"
+
+struct ChunkSpan;
+
+// On-disk cache of decoded scenes: vertex/index streams in the layout they're uploaded in, part ->
+// texture bindings and texture payloads ready for glTexImage. A cache file is mapped and used in
+// place, reopening a level is a few memcpys and uploads instead of a parse.
+class SceneCache {
+  public:
+    struct Key {
+        std::string path; // absolute
+        uint64_t size;
+        int64_t mtime;
+        uint64_t hash; // of the whole source file, put together from its chunk hashes
+    };
+
+    // all offsets are from the start of the cache file and 16-byte aligned
+    struct Part {
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        int32_t texture; // index into the scene's textures, -1 for none
+        uint32_t blended;
+        float boundsMin[3];
+        float boundsMax[3];
+        uint64_t vertices;  // float3
+        uint64_t normals;   // float3
+        uint64_t texcoords; // float2
+        uint64_t colors;    // ubyte4
+        uint64_t indices;   // ushort
+    };
+
+    struct Texture {
+        int32_t index;
+        int32_t format; // raylib PixelFormat
+        int32_t width;
+        int32_t height;
+        int32_t mips;
+        uint32_t reserved;
+        uint64_t hash; // content hash of the source blob, see TextureCache
+        uint64_t data;
+        uint64_t size;
+    };
+
+    // `chunks` is the file's SceneParser::indexChunks, only the bytes before the first chunk are hashed again.
+    // nullopt if the file can't be read or doesn't match `chunks` anymore
+    static std::optional<Key> makeKey(const std::string& filename, const std::vector<ChunkSpan>& chunks);
+    static std::string getCachePath(const Key& key);
+
+    // maps the cache file for `key`, false if there is none or it's stale. Marks it as used for trim()
+    bool open(const Key& key);
+    void close();
+
+    const std::vector<Part>& parts() const { return m_parts; }
+    const std::vector<Texture>& textures() const { return m_textures; }
+    const uint8_t* at(uint64_t offset) const { return m_file.data() + offset; }
+
+    class Writer {
+      public:
+        // the pointers must stay valid until write()
+        void addPart(const Part& part, const float* vertices, const float* normals, const float* texcoords,
+                     const uint8_t* colors, const uint16_t* indices);
+        // `data` can stay empty for a hash that was added before, the payload is stored once
+        void addTexture(const Texture& texture, std::vector<uint8_t> data);
+        // then trims the cache to `maxCacheBytes`, never removing the file just written
+        bool write(const Key& key, uint64_t maxCacheBytes);
+
+      private:
+        struct PendingPart {
+            Part part;
+            const float* vertices;
+            const float* normals;
+            const float* texcoords;
+            const uint8_t* colors;
+            const uint16_t* indices;
+        };
+        std::vector<PendingPart> m_parts;
+        std::vector<std::pair<Texture, std::vector<uint8_t>>> m_textures;
+    };
+
+  private:
+    // removes the cache files used least recently until the rest fit in `maxBytes`
+    static void trim(uint64_t maxBytes, const std::string& keep);
+
+    MappedFile m_file;
+    std::vector<Part> m_parts;
+    std::vector<Texture> m_textures;
+};
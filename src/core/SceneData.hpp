@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "types.hpp"
+#include "utils.hpp"
+
+// Renderer-agnostic result of parsing a scene file. Geometry is already decoded into flat streams (unless
+// deferred, see ParseOptions), textures are left as the DDS blobs the file stores
+
+enum class TextureFormat {
+    Unknown,
+    DXT1,
+    DXT1Alpha,
+    DXT5,
+    FloatRGBA // D3DFMT_A32B32G32R32F ("D3D 116")
+};
+
+struct TextureBlob {
+    std::unique_ptr<uint8_t[]> data; // the whole DDS file, or only levels from firstLevel on if partial
+    size_t size = 0;
+    size_t offset = 0; // of the DDS header in the file
+    uint64_t hash = 0; // xxh64 of data
+    TextureFormat format = TextureFormat::Unknown;
+    int width = 0;
+    int height = 0;
+    int mips = 0;
+    bool cubemap = false;
+    bool partial = false; // see ParseOptions
+    int firstLevel = 0;
+};
+
+struct MeshAttrib {
+    MeshValType valType; // position, normal, etc
+    MeshVarType varType; // vec4half, vec2mini, etc
+};
+
+// where a part's vertices and indices sit in the file, for decoding them later (see ParseOptions::deferGeometry)
+struct GeometryRef {
+    size_t vertices = 0; // offset of the part's first vertex
+    uint32_t vertexCount = 0;
+    uint32_t stride = 0;
+    std::vector<MeshAttrib> attribs;
+    size_t indices = 0; // offset of the part's first index, 16 bits each
+    uint32_t indexCount = 0;
+};
+
+struct ScenePart {
+    std::vector<float> positions; // xyz
+    std::vector<float> normals;   // xyz
+    std::vector<float> texcoords; // uv
+    std::vector<uint8_t> colors;  // rgba
+    std::vector<uint16_t> indices;
+    Vec3f boundsMin;
+    Vec3f boundsMax;
+    bool blended;     // some vertex alpha is below 255
+    int texture = -1; // index into SceneData::textures
+    // the file's buffers the streams were cut from, parts often share them. Indices are relative to vertexOffset
+    unsigned int vertexBuffer = 0;
+    unsigned int vertexOffset = 0;
+    unsigned int indexBuffer = 0;
+    unsigned int indexOffset = 0;
+    // streams left empty, only the bounds were read. `blended` is only known once decoded
+    bool deferred = false;
+    GeometryRef geometry;
+};
+
+// a vertex attribute the parser doesn't decode and skips, e.g. normals stored as Vec3f
+struct UnhandledAttrib {
+    MeshValType valType;
+    MeshVarType varType;
+    unsigned int buffers = 0;
+    size_t vertices = 0;
+    std::vector<size_t> parts = {}; // indices into SceneData::parts
+};
+
+struct SceneDiagnostics {
+    std::vector<UnhandledAttrib> unhandledAttribs;
+};
+
+struct SceneData {
+    std::vector<TextureBlob> textures;
+    std::vector<ScenePart> parts;
+    SceneDiagnostics diagnostics;
+};
@@ -0,0 +1,956 @@
+#include "SceneParser.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <sstream>
+#include <fmt/ranges.h>
+#include "Dxt.hpp"
+#include "Hash.hpp"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+#include "logger.hpp"
+#include "utils.hpp"
+#include "umHalf.h"
+
+// pairs the per-vertex loop decodes, anything else is skipped
+static bool isDecoded(const MeshAttrib& attrib) {
+    switch (attrib.valType) {
+    case MeshValType::Position:
+        return attrib.varType == MeshVarType::Vec4half || attrib.varType == MeshVarType::Vec3f;
+    case MeshValType::Normal:
+        return attrib.varType == MeshVarType::Vec4mini;
+    case MeshValType::ColorSet0:
+        return attrib.varType == MeshVarType::Col4char;
+    case MeshValType::UVSet1:
+        return attrib.varType == MeshVarType::Vec4half || attrib.varType == MeshVarType::Vec2half;
+    case MeshValType::Tangent:
+    case MeshValType::ColorSet1:
+    case MeshValType::Unknown:
+    case MeshValType::UVSet2:
+    case MeshValType::Unknown2:
+    case MeshValType::BlendIndices:
+    case MeshValType::BlendWeight:
+    case MeshValType::Unknown3:
+    case MeshValType::LightDirSet:
+    case MeshValType::LightColSet:
+        return true; // unused on purpose
+    default:
+        return false;
+    }
+}
+
+// for values the parser can't go on with, reported with the reader's position
+static void expect(BinReader& reader, bool condition, const char* reason) {
+    if (!condition) [[unlikely]]
+        throw ReadError(reason, reader.pos());
+}
+
+// larger than any GPU takes, so headers claiming more are garbage
+constexpr int maxTextureSize = 16384;
+
+// the DDS header sizes the blob, so it has to describe a texture that can exist. A mip count of 0 means there's
+// no chain and becomes 1
+static void expectTextureSize(BinReader& reader, int width, int height, int& mips) {
+    expect(reader, width > 0 && height > 0 && width <= maxTextureSize && height <= maxTextureSize, "texture size out of range");
+    auto maxMips = (int)std::bit_width((unsigned int)std::max(width, height));
+    expect(reader, mips >= 0 && mips <= maxMips, "texture mip count out of range");
+    mips = std::max(mips, 1);
+}
+
+std::string ParseError::message() const {
+    return fmt::format("{} at 0x{:08X}: {}", chunk, offset, reason);
+}
+
+SceneParser::SceneParser(const ParseOptions& options)
+    : m_options(options), m_refCounter(7), m_textureCount(0), m_chunk("FILE") {}
+
+bool SceneParser::parse(const std::string& filename, SceneData& out, ParseError* error) {
+    m_refCounter = 7;
+    m_textureCount = 0;
+    m_vertexBuffers.clear();
+    m_indexBuffers.clear();
+    m_vertexSpans.clear();
+    m_indexSpans.clear();
+    m_chunk = "FILE";
+    m_diagnostics = {};
+    m_unhandledBuffers.clear();
+    out = {};
+
+    try {
+        parseChunks(filename, out);
+        return true;
+    } catch (const ReadError& e) {
+        if (error)
+            *error = {m_chunk, e.offset(), e.what()};
+    } catch (const std::bad_alloc&) {
+        if (error)
+            *error = {m_chunk, 0, "out of memory"};
+    }
+    out = {};
+    return false;
+}
+
+void SceneParser::parseChunks(const std::string& filename, SceneData& out) {
+    NUEX_TRACE_SCOPE("parse");
+    logD("Parsing {}", filename);
+
+    auto reader = BinReader(filename, Endianness::Big);
+    NUEX_TRACE_BYTES(reader.length());
+
+    auto goodTexCount = readTxgh(reader);
+    auto meshMaterials = readDisp(reader);
+    auto matTextureIDs = readUmtl(reader);
+
+    // loading texture data
+    m_chunk = "TEXTURES";
+    if (m_options.readTextures)
+        loadTextures(reader, goodTexCount, out);
+    // parts may only refer to textures that exist, or would once read
+    m_textureCount = m_options.readTextures ? out.textures.size() : goodTexCount;
+
+    if (m_options.readMeshes)
+        readMesh(reader, meshMaterials, matTextureIDs, out);
+
+    for (const auto& attrib : m_diagnostics.unhandledAttribs) {
+        logW("MESH: Skipped unhandled vertex attribute (valType {}, varType {}) in {} buffers, {} vertices, {} parts",
+             (int)attrib.valType, (int)attrib.varType, attrib.buffers, attrib.vertices, attrib.parts.size());
+    }
+    out.diagnostics = std::move(m_diagnostics);
+}
+
+std::vector<ChunkSpan> SceneParser::indexChunks(const std::string& filename) {
+    NUEX_TRACE_SCOPE("indexChunks");
+    MappedFile file(filename);
+    if (!file.isOpen())
+        return {};
+    NUEX_TRACE_BYTES(file.size());
+
+    // like BinReader::find, the first match from the start of the file
+    auto view = std::string_view((const char*)file.data(), file.size());
+    std::vector<ChunkSpan> chunks;
+    constexpr std::pair<const char*, const char*> magics[] = {
+        {"TXGH", "HGXT"}, {"DISP", "PSID"}, {"UMTL", "LTMU"}, {"TEXTURES", "DDS "}, {"MESH", "HSEM"}};
+    for (auto [name, magic] : magics) {
+        auto offset = view.find(std::string_view(magic, 4));
+        if (offset != std::string_view::npos && offset != 0)
+            chunks.push_back({name, offset});
+    }
+
+    std::sort(chunks.begin(), chunks.end(), [](const auto& a, const auto& b) { return a.offset < b.offset; });
+    for (auto i = 0u; i < chunks.size(); i++) {
+        auto end = i + 1 < chunks.size() ? chunks[i + 1].offset : file.size();
+        chunks[i].size = end - chunks[i].offset;
+        chunks[i].hash = hash::xxh64(file.data() + chunks[i].offset, chunks[i].size);
+    }
+    return chunks;
+}
+
+uint32_t SceneParser::readTxgh(BinReader& reader) {
+    NUEX_TRACE_SCOPE("TXGH");
+    // load TXGH
+    m_chunk = "TXGH";
+    auto txghOffset = reader.find(std::string_view("HGXT", 4));
+    expect(reader, txghOffset != 0, "chunk not found");
+    logD("TXGH: Found at 0x{:08X}", txghOffset);
+    reader.seek(txghOffset);
+    reader.skip(4 + 4 + 4);
+    uint32_t texCount;
+    reader >> texCount;
+    logD("TXGH: {} textures", texCount);
+    reader.skip(texCount * 4 + 4);
+    reader >> texCount;
+    auto goodTexCount = texCount;
+    for (auto i = 0u; i < texCount; i++) {
+        reader.skip(16);
+        uint32_t nameLen;
+        reader >> nameLen;
+        if (nameLen > 0) {
+            expect(reader, nameLen <= reader.remaining(), "texture name past the end of the file");
+            std::string texName(nameLen, '\0');
+            reader.read((uint8_t*)texName.data(), nameLen);
+            logD("TXGH:   * Texture {}: {}", i, texName.c_str());
+        } else {
+            logD("TXGH:   * Texture {}: <no name>", i);
+            goodTexCount--;
+        }
+        reader.skip(2 + 1 + 1);
+    }
+    logD("TXGH: Good texture count: {} (of total {})", goodTexCount, texCount);
+    m_refCounter += goodTexCount; // i have 0 idea about how the heck this works but it does
+    reader.skip(4);
+    uint32_t unk;
+    reader >> unk;
+    m_refCounter += unk; // ¯\_(ツ)_/¯
+    NUEX_TRACE_BYTES(reader.pos() - txghOffset);
+    return goodTexCount;
+}
+
+std::unordered_map<int, int> SceneParser::readDisp(BinReader& reader) {
+    NUEX_TRACE_SCOPE("DISP");
+    // loading DISP
+    m_chunk = "DISP";
+    auto dispOffset = reader.find(std::string_view("PSID", 4));
+    expect(reader, dispOffset != 0, "chunk not found");
+    logD("DISP: Found at 0x{:08X}", dispOffset);
+    reader.seek(dispOffset);
+    reader.skip(4);
+    expect(reader, reader.read<uint32_t>() == 15, "unsupported version"); // version should be 15 for now
+    reader.skip(reader.read<uint32_t>());                                 // skip filePath
+    reader.skip(4);                                                       // ROTV
+
+    std::vector<int> commandIndices;
+    auto commandsCount = reader.read<uint32_t>();
+    expect(reader, commandsCount <= reader.remaining() / 6, "command count past the end of the file");
+    for (auto i = 0u; i < commandsCount; i++) {
+        auto cmd = reader.read<uint8_t>();
+        reader.skip(1);
+        auto index = reader.read<uint32_t>();
+        // if (cmd == 0xb3) {
+        //     logD("DISP: {} {:X} {}", i, cmd, index);
+        // }
+        commandIndices.push_back(index);
+    }
+
+    logD("DISP: {} commandIndices count", commandIndices.size());
+
+    std::unordered_map<int, int> meshMaterials;
+
+    reader.skip(4);
+    auto clipObjectsSize = reader.read<uint32_t>();
+    logD("DISP: clipObjectsSize = {}", clipObjectsSize);
+    for (auto i = 0u; i < clipObjectsSize; i++) {
+        reader.skip(2);
+
+        std::vector<int> mtlIndices;
+        auto mtlIndicesSize = reader.read<uint32_t>();
+        expect(reader, mtlIndicesSize <= reader.remaining() / 4, "material index count past the end of the file");
+        for (auto j = 0u; j < mtlIndicesSize; j++) {
+            mtlIndices.push_back(reader.read<uint32_t>());
+        }
+
+        // logD("mtlIndices.size = {}", mtlIndices.size());
+
+        auto itemIndicesSize = reader.read<uint32_t>();
+        expect(reader, itemIndicesSize <= mtlIndices.size(), "more clip items than materials");
+        for (auto j = 0u; j < itemIndicesSize; j++) {
+            auto cmdIndex = reader.read<uint32_t>();
+            expect(reader, cmdIndex < commandIndices.size(), "clip item references a missing command");
+            auto instanceIndex = commandIndices[cmdIndex];
+            // logD("i = {} j = {} index = {} instanceIndex = {} mtlIndex = {}", i, j, cmdIndex, instanceIndex, mtlIndices[j]);
+            meshMaterials[instanceIndex] = mtlIndices[j];
+        }
+    }
+
+    for (const auto [partIdx, mtlIdx] : meshMaterials) {
+        logD("DISP: Mesh part {}: material {}", partIdx, mtlIdx);
+    }
+    NUEX_TRACE_BYTES(reader.pos() - dispOffset);
+    return meshMaterials;
+}
+
+std::vector<int> SceneParser::readUmtl(BinReader& reader) {
+    NUEX_TRACE_SCOPE("UMTL");
+    // loading UMTL
+    m_chunk = "UMTL";
+    auto utmlOffset = reader.find(std::string_view("LTMU", 4));
+    expect(reader, utmlOffset != 0, "chunk not found");
+    logD("UMTL: Found at 0x{:08X}", utmlOffset);
+    reader.seek(utmlOffset);
+    reader.skip(4);
+    uint32_t umtlVer, mtlCount;
+    reader >> umtlVer >> mtlCount >> mtlCount; // its intended
+    logD("UTML: Version 0x{:X}, {} materials", umtlVer, mtlCount);
+    expect(reader, umtlVer == 0x94 || umtlVer == 0x95 || umtlVer == 0x96, "unsupported version");
+
+    std::vector<int> matTextureIDs;
+
+    for (auto i = 0u; i < mtlCount; i++) {
+        logD("UMTL:   * Material {}", i);
+        reader.skip(4 * 19 + 1 * 2 + 4 * 10 + 1 * 2 + (4 + 4) * 16 + 1 * 66 + 4 * 4 + (4 + 4 + 1) * 5 + 4 * 5 + 1 * 1);
+
+        int localTIDs[18];
+        for (auto i = 0u; i < 18; i++) {
+            reader >> localTIDs[i];
+        }
+
+        matTextureIDs.push_back(localTIDs[0]);
+
+        logD("UMTL:     localTIDs list: [{}]", fmt::join(localTIDs, ", "));
+
+        reader.skip(4 * reader.read<uint32_t>() * 3);
+        reader.skip(4 * 4 + (1 + 1 + 4 + 4 + 4 + 4) * 4 + 4 * 4 + 1 * 1 + 4 * 54 + 1 + 4 * 3);
+        if (umtlVer >= 0x95)
+            reader.skip(2);
+
+        auto nameStrLen = reader.read<uint16_t>();
+        std::string matName(nameStrLen, '\0');
+        reader.read((uint8_t*)matName.data(), nameStrLen);
+        logD("UMTL:     Material name: {}", matName.c_str());
+
+        reader.skip(4);
+        reader.skip(4 * 20 * 4 + 4 * 20 * 3 * 2);
+        reader.skip(reader.read<uint32_t>() * 3);
+        reader.skip(reader.read<uint32_t>() * 3);
+        reader.skip(4 * 2 + 1 * 3 + 1 * 2 + 1 + 1 * 21);
+        reader.skip(4 * 4);
+
+        auto localTID = reader.read<int32_t>();
+        logD("UMTL:     localTID: {}. Should be equal to localTIDs[0]", localTID);
+
+        reader.skip(1 * 2 + 2 * 2 + 1 * 2 + 4 * 6 + 1 * ((umtlVer >= 0x96) ? 16 : 15) + 4 * 2);
+
+        logD("UMTL:     Material ends at 0x{:08X}", reader.pos());
+    }
+
+    for (auto i = 0u; i < matTextureIDs.size(); i++) {
+        logD("UMTL: Material {}: Texture ID {}", i, matTextureIDs[i]);
+    }
+    NUEX_TRACE_BYTES(reader.pos() - utmlOffset);
+    return matTextureIDs;
+}
+
+void SceneParser::readMesh(BinReader& reader, std::unordered_map<int, int>& meshMaterials, const std::vector<int>& matTextureIDs,
+                           SceneData& out) {
+    NUEX_TRACE_SCOPE("MESH");
+    // loading MESH
+    m_chunk = "MESH";
+    auto meshOffset = reader.find(std::string_view("HSEM", 4));
+    expect(reader, meshOffset != 0, "chunk not found");
+    logD("MESH: Found at 0x{:08X}", meshOffset);
+    reader.seek(meshOffset);
+    reader.skip(4); // MESH 4cc
+    uint32_t ver;
+    reader >> ver;
+    logD("MESH: Version: 0x{:X}", ver);
+    expect(reader, ver >= 0x30, "unsupported version");
+    reader.skip(4); // ROTV
+    uint32_t len;   // parts count
+    reader >> len;
+    logD("MESH: {} parts", len);
+
+    for (auto i = 0u; i < len; i++) {
+        logD("MESH:   * Part {}", i);
+        MeshPart part;
+        auto material = meshMaterials[i];
+        part.textureID = material >= 0 && material < (int)matTextureIDs.size() ? matTextureIDs[material] : -1;
+
+        readPart(reader, part);
+        buildPart(part, out);
+    }
+    NUEX_TRACE_BYTES(reader.pos() - meshOffset);
+}
+
+void SceneParser::loadVertices(BinReader& reader, MeshPart& part) {
+    NUEX_TRACE_READER_SCOPE("loadVertices", reader);
+    // VERTICES
+    uint32_t size;
+    reader >> size;
+    expect(reader, size == 1 || size == 2, "unexpected vertex buffer count");
+
+    // VERTEX_SOMETHING
+    std::vector<MeshVertex> vertices;
+    part.vertexBufferID = m_refCounter;
+
+    for (auto i = 0; i < size; i++) {
+        uint32_t unk;
+        reader >> unk;
+        if (unk >> 3 * 8 == 0xC0) {
+            auto id = unk ^ 0xC0'00'00'00;
+            logD("MESH:     Reusing vertex buffer 0x{:X}", id);
+            if (i == 0)
+                part.vertexBufferID = id;
+            reader.skip(4 + 4);
+            continue;
+        }
+        if (!unk)
+            continue;
+
+        reader.skip(4); // flags
+        uint32_t count;
+        reader >> count;
+        logD("MESH:     New vertex buffer 0x{:X} of length 0x{:X}", m_refCounter, count);
+
+        uint32_t nbAttribs;
+        reader >> nbAttribs;
+
+        std::vector<MeshAttrib> attribs;
+        expect(reader, nbAttribs <= 32, "too many vertex attributes");
+
+        size_t stride = 0;
+        for (auto i = 0u; i < nbAttribs; i++) {
+            MeshAttrib attrib;
+            reader >> attrib.valType >> attrib.varType;
+            // logD("attrib: {} {}", (int)attrib.valType, (int)attrib.varType);
+            reader.skip(1); // offset of the attrib
+            attribs.push_back(attrib);
+            stride += utils::getVarSize(attrib.varType);
+        }
+        expect(reader, count * stride <= reader.remaining(), "vertex data past the end of the file");
+
+        // a second buffer has no id parts refer to, its attributes count for the part's first one
+        for (const auto& attrib : attribs) {
+            if (!isDecoded(attrib))
+                reportUnhandled(attrib, part.vertexBufferID, count);
+        }
+
+        if (m_options.deferGeometry) {
+            if (i == 0) {
+                recordVertices(reader, attribs, count, stride);
+            } else {
+                reader.skip(count * stride);
+            }
+        } else {
+            decodeVertices(reader, attribs, count, vertices);
+        }
+
+        reader.skip(4); // byteOffset
+
+        if (i == 0 && !m_options.deferGeometry)
+            m_vertexBuffers[m_refCounter] = vertices;
+        m_refCounter++;
+    }
+}
+
+void SceneParser::decodeVertices(BinReader& reader, const std::vector<MeshAttrib>& attribs, uint32_t count,
+                                 std::vector<MeshVertex>& out) {
+    for (auto i = 0u; i < count; i++) {
+        MeshVertex vertex;
+        vertex.pos = {0, 0, 0};
+        vertex.normal = {0, 0, 0};
+        vertex.uv = {0, 0};
+        vertex.color = {255, 255, 255, 255};
+
+        for (const auto& attrib : attribs) {
+            switch (attrib.valType) {
+            case MeshValType::Position: {
+                switch (attrib.varType) {
+                case MeshVarType::Vec4half: { // what
+                    half x, y, z;
+                    reader >> x >> y >> z;
+                    reader.skip(2);
+                    vertex.pos.x = (float)x;
+                    vertex.pos.y = (float)y;
+                    vertex.pos.z = (float)z;
+                } break;
+                case MeshVarType::Vec3f:
+                    // float x, y, z;
+                    reader >> vertex.pos.x >> vertex.pos.y >> vertex.pos.z;
+                    // reader >> x >> y >> z;
+                    // vertex.pos = {x, y, z};
+                    break;
+                default: // reported once per buffer
+                    reader.skip(utils::getVarSize(attrib.varType));
+                    break;
+                }
+            } break;
+            case MeshValType::Normal: {
+                switch (attrib.varType) {
+                // case MeshVarType::Vec3f:
+                //     reader >> vertex.normal.x >> vertex.normal.y >> vertex.normal.z;
+                //     break;
+                // case MeshVarType::Vec4f:
+                //     reader >> vertex.normal.x >> vertex.normal.y >> vertex.normal.z;
+                //     reader.skip(4);
+                //     break;
+                case MeshVarType::Vec4mini:
+                    unsigned char x, y, z;
+                    reader >> x >> y >> z;
+                    reader.skip(1); // w
+                    vertex.normal.x = utils::getMiniFloat(x);
+                    vertex.normal.y = utils::getMiniFloat(y);
+                    vertex.normal.z = utils::getMiniFloat(z);
+                    break;
+                default: // reported once per buffer
+                    reader.skip(utils::getVarSize(attrib.varType));
+                    break;
+                }
+            } break;
+            case MeshValType::ColorSet0: {
+                switch (attrib.varType) {
+                case MeshVarType::Col4char:
+                    reader >> vertex.color.r >> vertex.color.g >> vertex.color.b >> vertex.color.a;
+                    break;
+                default: // reported once per buffer
+                    reader.skip(utils::getVarSize(attrib.varType));
+                    break;
+                }
+            } break;
+            case MeshValType::UVSet1: {
+                switch (attrib.varType) {
+                case MeshVarType::Vec4half: { // what
+                    half x, y;
+                    reader >> x >> y;
+                    reader.skip(4);
+                    vertex.uv.x = (float)x;
+                    vertex.uv.y = (float)y;
+                } break;
+                case MeshVarType::Vec2half: {
+                    half x, y;
+                    reader >> x >> y;
+                    vertex.uv.x = (float)x;
+                    vertex.uv.y = (float)y;
+                } break;
+                default: // reported once per buffer
+                    reader.skip(utils::getVarSize(attrib.varType));
+                    break;
+                }
+            } break;
+            case MeshValType::Tangent:
+            case MeshValType::ColorSet1:
+            case MeshValType::Unknown:
+            case MeshValType::UVSet2:
+            case MeshValType::Unknown2:
+            case MeshValType::BlendIndices:
+            case MeshValType::BlendWeight:
+            case MeshValType::Unknown3:
+            case MeshValType::LightDirSet:
+            case MeshValType::LightColSet:
+                // unused
+                reader.skip(utils::getVarSize(attrib.varType));
+                break;
+            default: // reported once per buffer
+                reader.skip(utils::getVarSize(attrib.varType));
+                break;
+            }
+        }
+
+        out.push_back(vertex);
+    }
+}
+
+void SceneParser::recordVertices(BinReader& reader, const std::vector<MeshAttrib>& attribs, uint32_t count, uint32_t stride) {
+    auto& span = m_vertexSpans[m_refCounter];
+    span = {reader.pos(), count, stride, attribs, {}};
+    span.positions.assign(count, {0, 0, 0});
+
+    // one read for the whole buffer, then only the positions are picked out of it
+    std::vector<uint8_t> data((size_t)count * stride);
+    reader.read(data.data(), data.size());
+
+    size_t offset = 0;
+    for (const auto& attrib : attribs) {
+        if (attrib.valType == MeshValType::Position) {
+            auto get16 = [](const uint8_t* p) { return (uint16_t)(p[0] << 8 | p[1]); };
+            auto get32 = [](const uint8_t* p) { return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]; };
+            for (auto i = 0u; i < count; i++) {
+                auto src = data.data() + (size_t)i * stride + offset;
+                auto& pos = span.positions[i];
+                if (attrib.varType == MeshVarType::Vec3f) {
+                    pos = {std::bit_cast<float>(get32(src)), std::bit_cast<float>(get32(src + 4)),
+                           std::bit_cast<float>(get32(src + 8))};
+                } else if (attrib.varType == MeshVarType::Vec4half) {
+                    half x, y, z;
+                    x.GetBits() = get16(src);
+                    y.GetBits() = get16(src + 2);
+                    z.GetBits() = get16(src + 4);
+                    pos = {(float)x, (float)y, (float)z};
+                }
+            }
+            break;
+        }
+        offset += utils::getVarSize(attrib.varType);
+    }
+}
+
+void SceneParser::loadIndices(BinReader& reader, MeshPart& part) {
+    NUEX_TRACE_READER_SCOPE("loadIndices", reader);
+    uint32_t something;
+    reader >> something;
+
+    if (something >> 3 * 8 == 0xC0) { // reusing an index buffer
+        auto id = something ^ 0xC0'00'00'00;
+        logD("MESH:     Reusing index buffer 0x{:X}", id);
+        part.indexBufferID = id;
+        reader.skip(4);
+    } else {
+        reader.skip(4); // flags
+        uint32_t count, size;
+        reader >> count >> size;
+        logD("MESH:     New index buffer 0x{:X} of length 0x{:X}", m_refCounter, count);
+        expect(reader, size == 2, "unsupported index size");
+        expect(reader, count * 2ull <= reader.remaining(), "index data past the end of the file");
+
+        part.indexBufferID = m_refCounter;
+        if (m_options.deferGeometry) {
+            m_indexSpans[m_refCounter] = {reader.pos(), count};
+            reader.skip(count * 2ull);
+        } else {
+            std::vector<unsigned short> indices;
+
+            indices.resize(count);
+
+            for (auto i = 0u; i < count; i++) {
+                reader >> indices[i];
+            }
+
+            m_indexBuffers[m_refCounter] = indices;
+        }
+        m_refCounter++;
+    }
+
+    reader >> part.indexOffset >> part.indexCount >> part.vertexOffset;
+    reader.skip(2);
+    reader >> part.vertexCount;
+    // logD("indexOffset {}, indexCount {}, verticesOffset {}, verticesCount {}", part.indexOffset, part.indexCount,
+    //      part.vertexOffset, part.vertexCount);
+}
+
+void SceneParser::buildPart(const MeshPart& part, SceneData& out) {
+    NUEX_TRACE_SCOPE("buildPart");
+    auto& result = out.parts.emplace_back();
+    result.vertexBuffer = part.vertexBufferID;
+    result.vertexOffset = part.vertexOffset;
+    result.indexBuffer = part.indexBufferID;
+    result.indexOffset = part.indexOffset;
+
+    if (m_options.deferGeometry) {
+        recordPart(part, result);
+    } else {
+        const auto& indices = m_indexBuffers[part.indexBufferID];
+        const auto& vertices = m_vertexBuffers[part.vertexBufferID];
+        result.indices.assign(indices.begin() + part.indexOffset, indices.begin() + part.indexOffset + part.indexCount);
+        fillStreams(vertices.data() + part.vertexOffset, part.vertexCount, result);
+    }
+
+    if (auto it = m_unhandledBuffers.find(part.vertexBufferID); it != m_unhandledBuffers.end()) {
+        for (auto index : it->second) {
+            m_diagnostics.unhandledAttribs[index].parts.push_back(out.parts.size() - 1);
+        }
+    }
+
+    logD("MESH:     Part texture id: {}", part.textureID);
+    if (part.textureID > 2 && part.textureID < (int)m_textureCount)
+        result.texture = part.textureID;
+}
+
+static void growBounds(ScenePart& part, const Vec3f& pos, bool first) {
+    if (first) {
+        part.boundsMin = part.boundsMax = pos;
+        return;
+    }
+    part.boundsMin = {std::min(part.boundsMin.x, pos.x), std::min(part.boundsMin.y, pos.y), std::min(part.boundsMin.z, pos.z)};
+    part.boundsMax = {std::max(part.boundsMax.x, pos.x), std::max(part.boundsMax.y, pos.y), std::max(part.boundsMax.z, pos.z)};
+}
+
+void SceneParser::fillStreams(const MeshVertex* vertices, uint32_t count, ScenePart& out) {
+    out.positions.resize(count * 3);
+    out.normals.resize(count * 3);
+    out.texcoords.resize(count * 2);
+    out.colors.resize(count * 4);
+    out.blended = false;
+    out.boundsMin = {0, 0, 0};
+    out.boundsMax = {0, 0, 0};
+
+    for (auto i = 0u; i < count; i++) {
+        auto& vertex = vertices[i];
+        out.positions[i * 3 + 0] = vertex.pos.x;
+        out.positions[i * 3 + 1] = vertex.pos.y;
+        out.positions[i * 3 + 2] = vertex.pos.z;
+
+        out.normals[i * 3 + 0] = vertex.normal.x;
+        out.normals[i * 3 + 1] = vertex.normal.y;
+        out.normals[i * 3 + 2] = vertex.normal.z;
+
+        out.texcoords[i * 2 + 0] = vertex.uv.x;
+        out.texcoords[i * 2 + 1] = vertex.uv.y;
+
+        out.colors[i * 4 + 0] = vertex.color.r;
+        out.colors[i * 4 + 1] = vertex.color.g;
+        out.colors[i * 4 + 2] = vertex.color.b;
+        out.colors[i * 4 + 3] = vertex.color.a;
+        out.blended |= vertex.color.a != 255;
+
+        growBounds(out, vertex.pos, i == 0);
+    }
+}
+
+void SceneParser::recordPart(const MeshPart& part, ScenePart& out) {
+    const auto& vertices = m_vertexSpans[part.vertexBufferID];
+    const auto& indices = m_indexSpans[part.indexBufferID];
+    out.deferred = true;
+    out.blended = false;
+    out.geometry = {vertices.offset + (size_t)part.vertexOffset * vertices.stride,
+                    part.vertexCount,
+                    vertices.stride,
+                    vertices.attribs,
+                    indices.offset + (size_t)part.indexOffset * 2,
+                    part.indexCount};
+
+    out.boundsMin = {0, 0, 0};
+    out.boundsMax = {0, 0, 0};
+    for (auto i = 0u; i < part.vertexCount; i++) {
+        growBounds(out, vertices.positions[part.vertexOffset + i], i == 0);
+    }
+}
+
+void SceneParser::decodeGeometry(BinReader& reader, ScenePart& part) {
+    NUEX_TRACE_READER_SCOPE("decodeGeometry", reader);
+    const auto& ref = part.geometry;
+
+    reader.seek(ref.vertices);
+    expect(reader, (size_t)ref.vertexCount * ref.stride <= reader.remaining(), "vertex data past the end of the file");
+    std::vector<MeshVertex> vertices;
+    vertices.reserve(ref.vertexCount);
+    decodeVertices(reader, ref.attribs, ref.vertexCount, vertices);
+
+    reader.seek(ref.indices);
+    expect(reader, ref.indexCount * 2ull <= reader.remaining(), "index data past the end of the file");
+    part.indices.resize(ref.indexCount);
+    for (auto i = 0u; i < ref.indexCount; i++) {
+        reader >> part.indices[i];
+        // the file can have changed since the offsets were recorded, the GPU mustn't read past the part
+        expect(reader, part.indices[i] < ref.vertexCount, "index past the part's vertices");
+    }
+
+    fillStreams(vertices.data(), ref.vertexCount, part);
+    part.deferred = false;
+}
+
+size_t SceneParser::vertexBufferSize(unsigned int id) const {
+    if (m_options.deferGeometry) {
+        auto it = m_vertexSpans.find(id);
+        return it != m_vertexSpans.end() ? it->second.count : 0;
+    }
+    auto it = m_vertexBuffers.find(id);
+    return it != m_vertexBuffers.end() ? it->second.size() : 0;
+}
+
+size_t SceneParser::indexBufferSize(unsigned int id) const {
+    if (m_options.deferGeometry) {
+        auto it = m_indexSpans.find(id);
+        return it != m_indexSpans.end() ? it->second.count : 0;
+    }
+    auto it = m_indexBuffers.find(id);
+    return it != m_indexBuffers.end() ? it->second.size() : 0;
+}
+
+void SceneParser::reportUnhandled(const MeshAttrib& attrib, unsigned int bufferID, uint32_t vertexCount) {
+    auto& list = m_diagnostics.unhandledAttribs;
+    auto it = std::find_if(list.begin(), list.end(),
+                           [&](const auto& entry) { return entry.valType == attrib.valType && entry.varType == attrib.varType; });
+    if (it == list.end()) {
+        it = list.insert(list.end(), {.valType = attrib.valType, .varType = attrib.varType});
+        logD("MESH:     Unhandled vertex attribute (valType {}, varType {}), skipping it", (int)attrib.valType, (int)attrib.varType);
+    }
+    it->buffers++;
+    it->vertices += vertexCount;
+    // both vertex buffers of a part can have the same attribute
+    auto& indices = m_unhandledBuffers[bufferID];
+    if (auto index = (size_t)(it - list.begin()); std::find(indices.begin(), indices.end(), index) == indices.end())
+        indices.push_back(index);
+}
+
+void SceneParser::readPart(BinReader& reader, MeshPart& part) {
+    NUEX_TRACE_READER_SCOPE("part", reader);
+    loadVertices(reader, part);
+
+    uint32_t fastBlendVBSSize;
+    reader >> fastBlendVBSSize;
+    expect(reader, fastBlendVBSSize == 0, "fast blend vertex buffers aren't supported");
+    loadIndices(reader, part);
+
+    // the ranges buildPart cuts out
+    expect(reader, part.vertexCount == 0 || part.vertexOffset + (size_t)part.vertexCount <= vertexBufferSize(part.vertexBufferID),
+           "vertex range outside its buffer");
+    expect(reader, part.indexCount == 0 || part.indexOffset + (size_t)part.indexCount <= indexBufferSize(part.indexBufferID),
+           "index range outside its buffer");
+    // deferred parts are checked once decoded
+    if (!m_options.deferGeometry && part.indexCount > 0) {
+        auto indices = m_indexBuffers[part.indexBufferID].begin() + part.indexOffset;
+        expect(reader,
+               std::all_of(indices, indices + part.indexCount, [&](auto index) { return index < part.vertexCount; }),
+               "index past the part's vertices");
+    }
+
+    // skip the remaining part
+
+    reader.skip(4);
+
+    uint32_t skinMtxMapSize;
+    reader >> skinMtxMapSize;
+    reader.skip(skinMtxMapSize);
+    if (skinMtxMapSize > 0) {
+        m_refCounter++;
+    }
+
+    // dynamic parts
+    uint32_t dynamicBufferCheck;
+    reader >> dynamicBufferCheck;
+    if (dynamicBufferCheck != 0) {
+        logD("MESH:     Reading relative position list (at 0x{:08X})", reader.pos());
+        reader.skip(4);
+        int num = 1;
+        int num2 = 0;
+        while (reader.read<uint32_t>() != 0) {
+            reader.skip(4);
+            num++;
+        }
+        logD("MESH:     RelPos lists: {}", num);
+        for (auto i = 0u; i < num; i++) {
+            auto num3 = reader.read<int>();
+            logD("MESH:       * RelPos list {} (type {})", i, num3);
+            if (num3 == 0) {
+                reader.skip(5 + 4 + 4);
+                auto num4 = reader.read<int>();
+                logD("MESH:         RelPos size: {}", num4);
+                reader.skip(num4);
+                num2++;
+                auto num5 = reader.read<int>();
+                logD("MESH:         RelPos tupels: {}", num5);
+                reader.skip(4 * num5);
+                if (num5 > 0) {
+                    num2++;
+                }
+                num2++;
+            } else {
+                num2++;
+                num2++;
+                reader.skip(12 * num3 + 21);
+            }
+        }
+
+        m_refCounter += num2;
+    }
+
+    reader.skip(4 + 16 + 16 + 4 + 4);
+
+    // unk VERTEX_SOMETHING
+    uint32_t unk;
+    reader >> unk;
+    expect(reader, unk == 0, "unexpected second vertex stream");
+
+    reader.skip(4 + 4);
+
+    // unk INDICES
+    uint32_t unkIndexesUnk;
+    reader >> unkIndexesUnk;
+    expect(reader, unkIndexesUnk == 0, "unexpected second index stream");
+
+    reader.skip(4 + 4 + 4);
+
+    m_refCounter++;
+}
+
+void SceneParser::loadTextures(BinReader& reader, int count, SceneData& out) {
+    NUEX_TRACE_SCOPE("loadTextures");
+    auto firstTex = reader.find(std::string_view("DDS ", 4));
+    if (firstTex == 0) {
+        logW("TEXTURES: There are no textures in the file!");
+        return;
+    }
+
+    logD("TEXTURES: Textures start address found at 0x{:08X}", firstTex);
+    reader.seek(firstTex);
+
+    reader.setEndianness(Endianness::Little);
+
+    auto& blobs = out.textures;
+    expect(reader, (size_t)count <= reader.remaining() / 128, "more textures than fit in the file");
+    blobs.resize(count);
+
+    for (auto i = 0u; i < count; i++) {
+        NUEX_TRACE_SCOPE("texture");
+        auto startPos = reader.pos();
+        logD("TEXTURES:   * Loading texture {} at 0x{:08X}", i, startPos);
+
+        size_t dataLen = 0;
+
+        auto& blob = blobs[i];
+        blob.offset = startPos;
+
+        reader.seek(startPos + 84);
+        auto type = reader.read<uint32_t>();
+        switch (type) {
+        case 0x31'54'58'44: { // DXT1
+            logD("TEXTURES:     Texture type: DXT1");
+            int num1, num2;
+            reader.seek(startPos + 12);
+            reader >> num1 >> num2;
+            reader.seek(startPos + 28);
+            int int32_1 = reader.read<uint32_t>();
+            reader.seek(startPos + 112);
+            int int32_2 = reader.read<uint32_t>();
+            logD("TEXTURES:     Texture info: {}x{}, {} mips, cubeMapFlags: {:08X}", num2, num1, int32_1, int32_2);
+            expectTextureSize(reader, num2, num1, int32_1);
+            reader.seek(startPos + 80);
+            auto alpha = reader.read<uint32_t>() & 1; // DDPF_ALPHAPIXELS
+            blob.format = alpha ? TextureFormat::DXT1Alpha : TextureFormat::DXT1;
+            blob.width = num2;
+            blob.height = num1;
+            blob.mips = int32_1;
+            blob.cubemap = int32_2 != 0;
+            dataLen = dxt::getStoredSize(num2, num1, int32_1, false) * (int32_2 != 0 ? 6 : 1) + 128;
+        } break;
+        case 0x35'54'58'44: { // DXT5
+            logD("TEXTURES:     Texture type: DXT5");
+            reader.seek(startPos + 12);
+            int num1, num2;
+            reader >> num1 >> num2;
+            reader.seek(startPos + 28);
+            int int32_1 = reader.read<uint32_t>();
+            reader.seek(startPos + 112);
+            int int32_2 = reader.read<uint32_t>();
+            logD("TEXTURES:     Texture info: {}x{}, {} mips, cubeMapFlags: {:08X}", num2, num1, int32_1, int32_2);
+            expectTextureSize(reader, num2, num1, int32_1);
+            blob.format = TextureFormat::DXT5;
+            blob.width = num2;
+            blob.height = num1;
+            blob.mips = int32_1;
+            blob.cubemap = int32_2 != 0;
+            dataLen = dxt::getStoredSize(num2, num1, int32_1, true) * (int32_2 != 0 ? 6 : 1) + 128;
+        } break;
+        case 116: { // D3D
+            logD("TEXTURES:     Texture type: D3D");
+            reader.seek(startPos + 12);
+            int int32_1, int32_2;
+            reader >> int32_1 >> int32_2;
+            reader.seek(startPos + 28);
+            int int32_3 = reader.read<uint32_t>();
+            logD("TEXTURES:     Texture info: {}x{}, {} mips", int32_2, int32_1, int32_3);
+            expectTextureSize(reader, int32_2, int32_1, int32_3);
+            // 4 floats per texel, converted to something smaller below
+            dataLen = dxt::getMipChainTexels(int32_2, int32_1, int32_3) * 16 + 128;
+            blob.format = TextureFormat::FloatRGBA;
+            blob.width = int32_2;
+            blob.height = int32_1;
+            blob.mips = int32_3;
+        } break;
+        default:
+            expect(reader, false, "unknown texture type");
+        }
+
+        logD("TEXTURES:     Texture data length: 0x{:08X}", dataLen);
+
+        // only textures with their own mip chain can drop levels, cubemaps are always read whole
+        auto skipped = 0u;
+        auto compressed =
+            blob.format == TextureFormat::DXT1 || blob.format == TextureFormat::DXT1Alpha || blob.format == TextureFormat::DXT5;
+        if (m_options.partialTextureSize > 0 && compressed && blob.mips > 1 && !blob.cubemap) {
+            blob.partial = true;
+            blob.firstLevel = dxt::getFirstLevelWithin(blob.width, blob.height, blob.mips, m_options.partialTextureSize);
+            skipped = 128 + dxt::getStoredLevelOffset(blob.width, blob.height, blob.firstLevel, blob.format == TextureFormat::DXT5);
+            logD("TEXTURES:     Reading from mip {} on", blob.firstLevel);
+        }
+
+        expect(reader, dataLen <= reader.length() - startPos, "texture data past the end of the file");
+        reader.seek(startPos + skipped);
+        blob.data = std::make_unique<uint8_t[]>(dataLen - skipped);
+        blob.size = dataLen - skipped;
+        reader.read(blob.data.get(), blob.size);
+        NUEX_TRACE_BYTES(blob.size);
+
+        reader.seek(startPos + dataLen);
+    }
+
+    // identical payloads are shared by the viewer's texture cache, partially read blobs hash only what was read
+    ThreadPool::shared().parallelFor(count, [&](size_t begin, size_t end) {
+        NUEX_TRACE_SCOPE("hashTextures");
+        for (auto i = begin; i < end; i++) {
+            blobs[i].hash = hash::xxh64(blobs[i].data.get(), blobs[i].size);
+            NUEX_TRACE_BYTES(blobs[i].size);
+        }
+    });
+
+    reader.setEndianness(Endianness::Big);
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "BinReader.hpp"
+#include "SceneData.hpp"
+#include "types.hpp"
+
+struct MeshVertex {
+    Vec3f pos;
+    Vec3f normal;
+    Col4u color;
+    Vec2f uv;
+};
+
+struct MeshPart {
+    unsigned int vertexBufferID;
+    unsigned int indexBufferID;
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    unsigned int vertexOffset;
+    unsigned int vertexCount;
+    int textureID;
+};
+
+struct ParseOptions {
+    // DXT textures with a mip chain are only read from the first level whose larger side fits this
+    // size on (for streaming the rest later), 0 reads them whole
+    int partialTextureSize = 0;
+    // reloads skip what didn't change: the texture blobs (SceneData::textures stays empty) or MESH (no parts)
+    bool readTextures = true;
+    bool readMeshes = true;
+    // MESH only records where each part's vertices and indices are (ScenePart::geometry) and reads the
+    // positions for its bounds, SceneParser::decodeGeometry reads the rest once the part is needed
+    bool deferGeometry = false;
+};
+
+// where a chunk sits in the file, up to the start of the next one, and a hash of those bytes
+struct ChunkSpan {
+    std::string name; // TXGH, DISP, UMTL, TEXTURES (all the DDS blobs) or MESH
+    size_t offset = 0;
+    size_t size = 0;
+    uint64_t hash = 0;
+
+    bool operator==(const ChunkSpan&) const = default;
+};
+
+// where and why parsing a file stopped
+struct ParseError {
+    std::string chunk; // TXGH, DISP, UMTL, TEXTURES, MESH, or FILE when it couldn't be opened
+    size_t offset = 0; // in the file
+    std::string reason;
+
+    std::string message() const;
+};
+
+// Reads TXGH, DISP, UMTL, the texture blobs and MESH of a .gsc/.ghg into SceneData. Needs neither a
+// window nor a GL context
+class SceneParser {
+  public:
+    explicit SceneParser(const ParseOptions& options = {});
+
+    // false for files that can't be opened, are cut short or hold values the parser doesn't know; `out` is
+    // left empty then
+    bool parse(const std::string& filename, SceneData& out, ParseError* error = nullptr);
+    // finds the chunks the same way parse() does and hashes them, for telling which ones an edit touched.
+    // Empty if the file can't be opened, chunks that aren't found are left out
+    static std::vector<ChunkSpan> indexChunks(const std::string& filename);
+    // fills the streams of a deferred part from its file. Throws ReadError, also when the file changed so
+    // much since it was parsed that the recorded ranges don't hold valid geometry anymore
+    static void decodeGeometry(BinReader& reader, ScenePart& part);
+
+    // single chunks, public for the benchmarks. They read from the reader's position on and throw ReadError
+    void loadVertices(BinReader& reader, MeshPart& part);
+    void loadIndices(BinReader& reader, MeshPart& part);
+    // cuts a part's streams out of the buffers read so far
+    void buildPart(const MeshPart& part, SceneData& out);
+
+  private:
+    // where a buffer's data is, in deferred mode
+    struct VertexSpan {
+        size_t offset = 0;
+        uint32_t count = 0;
+        uint32_t stride = 0;
+        std::vector<MeshAttrib> attribs;
+        std::vector<Vec3f> positions; // for the bounds
+    };
+    struct IndexSpan {
+        size_t offset = 0;
+        uint32_t count = 0;
+    };
+
+    static void decodeVertices(BinReader& reader, const std::vector<MeshAttrib>& attribs, uint32_t count,
+                               std::vector<MeshVertex>& out);
+    static void fillStreams(const MeshVertex* vertices, uint32_t count, ScenePart& out);
+    void parseChunks(const std::string& filename, SceneData& out);
+    // good texture count
+    uint32_t readTxgh(BinReader& reader);
+    // mesh part -> material
+    std::unordered_map<int, int> readDisp(BinReader& reader);
+    // material -> texture
+    std::vector<int> readUmtl(BinReader& reader);
+    void readMesh(BinReader& reader, std::unordered_map<int, int>& meshMaterials, const std::vector<int>& matTextureIDs,
+                  SceneData& out);
+    void reportUnhandled(const MeshAttrib& attrib, unsigned int bufferID, uint32_t vertexCount);
+    void readPart(BinReader& reader, MeshPart& part);
+    void recordVertices(BinReader& reader, const std::vector<MeshAttrib>& attribs, uint32_t count, uint32_t stride);
+    void recordPart(const MeshPart& part, ScenePart& out);
+    // vertices or indices a buffer read so far holds, 0 for unknown ones
+    size_t vertexBufferSize(unsigned int id) const;
+    size_t indexBufferSize(unsigned int id) const;
+    void loadTextures(BinReader& reader, int count, SceneData& out);
+
+    ParseOptions m_options;
+    std::unordered_map<unsigned int, std::vector<MeshVertex>> m_vertexBuffers;
+    std::unordered_map<unsigned int, std::vector<unsigned short>> m_indexBuffers;
+    std::unordered_map<unsigned int, VertexSpan> m_vertexSpans;
+    std::unordered_map<unsigned int, IndexSpan> m_indexSpans;
+    unsigned int m_refCounter;
+    size_t m_textureCount;
+    const char* m_chunk; // being read, for ParseError
+    SceneDiagnostics m_diagnostics;
+    std::unordered_map<unsigned int, std::vector<size_t>> m_unhandledBuffers; // vertex buffer -> m_diagnostics entries
+};
@@ -0,0 +1,467 @@
+#include "SynthScene.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include "BinWriter.hpp"
+#include "Dxt.hpp"
+#include "logger.hpp"
+
+namespace {
+    // SceneParser's m_refCounter before TXGH adds the texture count
+    constexpr uint32_t firstBufferId = 7;
+    constexpr size_t flushSize = 8 * 1024 * 1024;
+
+    // xorshift64*, plenty for noise and layout decisions
+    class Random {
+      public:
+        explicit Random(uint64_t seed) : m_state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+        uint64_t next() {
+            m_state ^= m_state >> 12;
+            m_state ^= m_state << 25;
+            m_state ^= m_state >> 27;
+            return m_state * 0x2545F4914F6CDD1Dull;
+        }
+
+        float unit() { return (next() >> 40) / (float)(1 << 24); }
+
+      private:
+        uint64_t m_state;
+    };
+
+    struct TextureInfo {
+        TextureFormat format;
+        int size;
+        int mips;
+        size_t dataSize; // header excluded
+    };
+
+    TextureInfo getTextureInfo(const SynthOptions& options, int index) {
+        TextureInfo info;
+        info.format = options.textureFormats[index % options.textureFormats.size()];
+        info.size = std::max(options.textureSize, 4);
+        info.mips = options.textureMips > 0 ? options.textureMips : (int)std::log2(info.size) + 1;
+        if (info.format == TextureFormat::FloatRGBA)
+            info.dataSize = dxt::getMipChainTexels(info.size, info.size, info.mips) * 16;
+        else
+            info.dataSize = dxt::getStoredSize(info.size, info.size, info.mips, info.format == TextureFormat::DXT5);
+        return info;
+    }
+
+    unsigned char toMiniFloat(float value) {
+        return (unsigned char)std::clamp((int)std::lround((value + 1.f) * 127.f), 0, 255);
+    }
+
+    int getGridSide(const SynthOptions& options) {
+        return std::clamp((int)std::sqrt((double)options.partVertices), 2, 256);
+    }
+
+    size_t getVertexStride(const SynthLayout& layout) {
+        size_t stride = 0;
+        for (const auto& attrib : layout) {
+            stride += utils::getVarSize(attrib.var);
+        }
+        return stride;
+    }
+
+    std::vector<std::string_view> split(std::string_view text, char separator) {
+        std::vector<std::string_view> result;
+        while (!text.empty()) {
+            auto end = text.find(separator);
+            result.push_back(text.substr(0, end));
+            text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+        }
+        return result;
+    }
+
+    void writeTxgh(BinWriter& out, const SynthOptions& options) {
+        out.bytes("HGXT", 4);
+        out.pad(8);
+        out.put<uint32_t>(options.textures);
+        out.pad(options.textures * 4 + 4);
+        out.put<uint32_t>(options.textures);
+        for (auto i = 0; i < options.textures; i++) {
+            auto name = fmt::format("synth_tex_{}", i);
+            out.pad(16);
+            out.put<uint32_t>(name.size() + 1);
+            out.bytes(name.c_str(), name.size() + 1);
+            out.pad(2 + 1 + 1);
+        }
+        out.pad(4);
+        out.put<uint32_t>(0); // added to the buffer ids
+    }
+
+    void writeDisp(BinWriter& out, int parts, int materials) {
+        constexpr std::string_view filePath = "synthetic\\synth.gsc";
+        out.bytes("PSID", 4);
+        out.put<uint32_t>(15);
+        out.put<uint32_t>(filePath.size());
+        out.bytes(filePath.data(), filePath.size());
+        out.pad(4); // ROTV
+
+        // a draw command per part and one clip object binding them all to materials
+        out.put<uint32_t>(parts);
+        for (auto i = 0; i < parts; i++) {
+            out.put<uint8_t>(0xB3);
+            out.pad(1);
+            out.put<uint32_t>(i);
+        }
+        out.pad(4);
+        out.put<uint32_t>(1);
+        out.pad(2);
+        out.put<uint32_t>(parts);
+        for (auto i = 0; i < parts; i++) {
+            out.put<uint32_t>(i % materials);
+        }
+        out.put<uint32_t>(parts);
+        for (auto i = 0; i < parts; i++) {
+            out.put<uint32_t>(i);
+        }
+    }
+
+    void writeUmtl(BinWriter& out, const SynthOptions& options, int materials) {
+        auto version = options.umtlVersion;
+        out.bytes("LTMU", 4);
+        out.put<uint32_t>(version);
+        out.put<uint32_t>(materials);
+        out.put<uint32_t>(materials);
+
+        for (auto i = 0; i < materials; i++) {
+            int32_t texture = options.textures > 3 ? 3 + i : -1;
+            auto name = fmt::format("synth_mtl_{}", i);
+
+            out.pad(4 * 19 + 1 * 2 + 4 * 10 + 1 * 2 + (4 + 4) * 16 + 1 * 66 + 4 * 4 + (4 + 4 + 1) * 5 + 4 * 5 + 1 * 1);
+            for (auto j = 0; j < 18; j++) {
+                out.put<int32_t>(j == 0 ? texture : -1);
+            }
+            out.put<uint32_t>(0);
+            out.pad(4 * 4 + (1 + 1 + 4 + 4 + 4 + 4) * 4 + 4 * 4 + 1 * 1 + 4 * 54 + 1 + 4 * 3);
+            if (version >= 0x95)
+                out.pad(2);
+            out.put<uint16_t>(name.size() + 1);
+            out.bytes(name.c_str(), name.size() + 1);
+            out.pad(4 + 4 * 20 * 4 + 4 * 20 * 3 * 2);
+            out.put<uint32_t>(0);
+            out.put<uint32_t>(0);
+            out.pad(4 * 2 + 1 * 3 + 1 * 2 + 1 + 1 * 21 + 4 * 4);
+            out.put<int32_t>(texture);
+            out.pad(1 * 2 + 2 * 2 + 1 * 2 + 4 * 6 + 1 * ((version >= 0x96) ? 16 : 15) + 4 * 2);
+        }
+    }
+
+    void writeTexture(BinWriter& out, const TextureInfo& info, Random& random) {
+        auto isFloat = info.format == TextureFormat::FloatRGBA;
+        auto fourCC = isFloat ? std::string_view("\x74\0\0\0", 4)
+                              : std::string_view(info.format == TextureFormat::DXT5 ? "DXT5" : "DXT1", 4);
+
+        // DDS header, little-endian like the payload
+        out.setEndianness(Endianness::Little);
+        out.bytes("DDS ", 4);
+        out.put<uint32_t>(124);
+        out.put<uint32_t>(0x1 | 0x2 | 0x4 | 0x1000 | 0x80000 | (info.mips > 1 ? 0x20000 : 0));
+        out.put<uint32_t>(info.size); // height
+        out.put<uint32_t>(info.size); // width
+        out.put<uint32_t>(isFloat ? info.size * info.size * 16
+                                  : dxt::getStoredLevelSize(info.size, info.size, 0, info.format == TextureFormat::DXT5));
+        out.put<uint32_t>(0);
+        out.put<uint32_t>(info.mips);
+        out.pad(4 * 11);
+        out.put<uint32_t>(32);
+        out.put<uint32_t>(0x4 | (info.format == TextureFormat::DXT1Alpha ? 0x1 : 0)); // DDPF_FOURCC, DDPF_ALPHAPIXELS
+        out.bytes(fourCC.data(), 4);
+        out.pad(4 * 5);
+        out.put<uint32_t>(0x1000 | (info.mips > 1 ? 0x400008 : 0));
+        out.pad(4 * 4); // no cubemap flags
+        out.setEndianness(Endianness::Big);
+
+        std::vector<uint8_t> data(info.dataSize);
+        if (isFloat) {
+            for (size_t i = 0; i < data.size(); i += 4) {
+                auto value = random.unit();
+                std::memcpy(&data[i], &value, 4);
+            }
+        } else {
+            for (size_t i = 0; i + 8 <= data.size(); i += 8) {
+                auto value = random.next();
+                std::memcpy(&data[i], &value, 8);
+            }
+        }
+        // the parser looks MESH up from the start of the file, noise mustn't contain its tag
+        for (size_t i = 0; i + 4 <= data.size(); i++) {
+            if (std::memcmp(&data[i], "HSEM", 4) == 0)
+                data[i] ^= 1;
+        }
+        out.bytes(data.data(), data.size());
+    }
+
+    // a displaced patch in its own cell, indices are local to the patch
+    void writeVertices(BinWriter& out, const SynthLayout& layout, int part, int columns, int side) {
+        constexpr float cellSize = 16.f;
+        constexpr float patchSize = 14.f;
+        auto originX = (part % columns) * cellSize;
+        auto originZ = (part / columns) * cellSize;
+        auto phase = part * 0.37f;
+        unsigned char color[4] = {(unsigned char)(80 + part * 37 % 176), (unsigned char)(80 + part * 91 % 176),
+                                  (unsigned char)(80 + part * 53 % 176), 255};
+
+        for (auto z = 0; z < side; z++) {
+            for (auto x = 0; x < side; x++) {
+                auto u = x / (float)(side - 1), v = z / (float)(side - 1);
+                auto px = originX + u * patchSize, pz = originZ + v * patchSize;
+                auto py = std::sin(u * 6.f + phase) * std::cos(v * 6.f) * 2.f;
+                // normal from the height's derivatives
+                auto dx = std::cos(u * 6.f + phase) * std::cos(v * 6.f) * 12.f / patchSize;
+                auto dz = -std::sin(u * 6.f + phase) * std::sin(v * 6.f) * 12.f / patchSize;
+                auto length = std::sqrt(dx * dx + 1.f + dz * dz);
+                float normal[3] = {-dx / length, 1.f / length, -dz / length};
+
+                for (const auto& attrib : layout) {
+                    if (attrib.val == MeshValType::Position && attrib.var == MeshVarType::Vec3f) {
+                        out.put(px);
+                        out.put(py);
+                        out.put(pz);
+                    } else if (attrib.val == MeshValType::Position && attrib.var == MeshVarType::Vec4half) {
+                        out.putHalf(px);
+                        out.putHalf(py);
+                        out.putHalf(pz);
+                        out.putHalf(1.f);
+                    } else if (attrib.val == MeshValType::Normal && attrib.var == MeshVarType::Vec4mini) {
+                        out.put(toMiniFloat(normal[0]));
+                        out.put(toMiniFloat(normal[1]));
+                        out.put(toMiniFloat(normal[2]));
+                        out.put(toMiniFloat(0.f));
+                    } else if (attrib.val == MeshValType::ColorSet0 && attrib.var == MeshVarType::Col4char) {
+                        out.bytes(color, 4);
+                    } else if (attrib.val == MeshValType::UVSet1 &&
+                               (attrib.var == MeshVarType::Vec2half || attrib.var == MeshVarType::Vec4half)) {
+                        out.putHalf(u * 4.f);
+                        out.putHalf(v * 4.f);
+                        if (attrib.var == MeshVarType::Vec4half)
+                            out.pad(4);
+                    } else {
+                        // the parser skips these
+                        out.pad(utils::getVarSize(attrib.var));
+                    }
+                }
+            }
+        }
+    }
+
+    void writeIndices(BinWriter& out, int side) {
+        for (auto z = 0; z + 1 < side; z++) {
+            for (auto x = 0; x + 1 < side; x++) {
+                uint16_t i = z * side + x;
+                uint16_t quad[6] = {i, (uint16_t)(i + side), (uint16_t)(i + 1), (uint16_t)(i + 1), (uint16_t)(i + side),
+                                    (uint16_t)(i + side + 1)};
+                for (auto index : quad) {
+                    out.put(index);
+                }
+            }
+        }
+    }
+} // namespace
+
+namespace synth {
+    bool writeScene(const std::string& path, const SynthOptions& options, SynthStats* stats) {
+        if (options.layouts.empty() || options.textureFormats.empty() || options.textures < 0 ||
+            (options.umtlVersion < 0x94 || options.umtlVersion > 0x96)) {
+            logE("SYNTH: Invalid options");
+            return false;
+        }
+
+        std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+        if (!stream) {
+            logE("SYNTH: Couldn't create {}", path);
+            return false;
+        }
+
+        std::vector<TextureInfo> textures;
+        uint64_t textureBytes = 0;
+        for (auto i = 0; i < options.textures; i++) {
+            textures.push_back(getTextureInfo(options, i));
+            textureBytes += textures.back().dataSize + 128;
+        }
+
+        auto side = getGridSide(options);
+        auto vertexCount = (uint32_t)(side * side);
+        auto indexCount = (uint32_t)((side - 1) * (side - 1) * 6);
+
+        auto parts = std::max(options.parts, 1);
+        if (options.targetSize > 0) {
+            size_t stride = 0;
+            for (const auto& layout : options.layouts) {
+                stride += getVertexStride(layout);
+            }
+            stride /= options.layouts.size();
+            auto partBytes = vertexCount * stride + indexCount * 2 + 140;
+            auto available = options.targetSize > textureBytes ? options.targetSize - textureBytes : 0;
+            parts = (int)std::clamp<uint64_t>(available / partBytes, 1, INT32_MAX / 2);
+        }
+        auto materials = std::max(options.textures - 3, 1);
+        auto columns = (int)std::ceil(std::sqrt((double)parts));
+
+        // buffer groups: the first part of a group stores the vertex and index buffers, the others reuse them
+        Random random(options.seed);
+        std::vector<int> groups;
+        for (auto i = 0; i < parts; i++) {
+            // keeps a group's vertex offsets well inside 32 bits
+            auto full = !groups.empty() && (uint64_t)groups.back() * vertexCount >= (1u << 24);
+            if (groups.empty() || full || random.unit() >= options.sharedRatio)
+                groups.push_back(0);
+            groups.back()++;
+        }
+
+        BinWriter out(stream, Endianness::Big);
+        out.put<uint32_t>(1); // file header, keeps TXGH off offset 0
+        out.pad(4);
+        writeTxgh(out, options);
+        writeDisp(out, parts, materials);
+        writeUmtl(out, options, materials);
+        out.flush();
+
+        for (const auto& texture : textures) {
+            writeTexture(out, texture, random);
+            out.flushIfAbove(flushSize);
+        }
+
+        out.bytes("HSEM", 4);
+        out.put<uint32_t>(0x30);
+        out.pad(4); // ROTV
+        out.put<uint32_t>(parts);
+
+        // mirrors the parser's buffer ids so parts can point back at a group's buffers
+        auto bufferId = firstBufferId + options.textures;
+        auto part = 0;
+        for (auto g = 0u; g < groups.size(); g++) {
+            const auto& layout = options.layouts[g % options.layouts.size()];
+            uint32_t vertexBuffer = 0, indexBuffer = 0;
+
+            for (auto i = 0; i < groups[g]; i++, part++) {
+                out.put<uint32_t>(1); // vertex buffers in this part
+                if (i == 0) {
+                    vertexBuffer = bufferId++;
+                    out.put<uint32_t>(1);
+                    out.pad(4); // flags
+                    out.put<uint32_t>(vertexCount * groups[g]);
+                    out.put<uint32_t>(layout.size());
+                    for (auto a = 0u; a < layout.size(); a++) {
+                        out.put((uint8_t)layout[a].val);
+                        out.put((uint8_t)layout[a].var);
+                        out.put<uint8_t>(0);
+                    }
+                    for (auto j = 0; j < groups[g]; j++) {
+                        writeVertices(out, layout, part + j, columns, side);
+                        out.flushIfAbove(flushSize);
+                    }
+                    out.pad(4); // byteOffset
+                } else {
+                    out.put<uint32_t>(0xC0'00'00'00 | vertexBuffer);
+                    out.pad(8);
+                }
+
+                out.put<uint32_t>(0); // fastBlendVBSSize
+
+                if (i == 0) {
+                    indexBuffer = bufferId++;
+                    out.put<uint32_t>(1);
+                    out.pad(4); // flags
+                    out.put<uint32_t>(indexCount * groups[g]);
+                    out.put<uint32_t>(2);
+                    for (auto j = 0; j < groups[g]; j++) {
+                        writeIndices(out, side);
+                        out.flushIfAbove(flushSize);
+                    }
+                } else {
+                    out.put<uint32_t>(0xC0'00'00'00 | indexBuffer);
+                    out.pad(4);
+                }
+                out.put<uint32_t>(indexCount * i);
+                out.put<uint32_t>(indexCount);
+                out.put<uint32_t>(vertexCount * i);
+                out.pad(2);
+                out.put<uint32_t>(vertexCount);
+
+                // no skinning, no dynamic buffers, the rest is skipped
+                out.pad(4);
+                out.put<uint32_t>(0);
+                out.put<uint32_t>(0);
+                out.pad(4 + 16 + 16 + 4 + 4);
+                out.put<uint32_t>(0);
+                out.pad(4 + 4);
+                out.put<uint32_t>(0);
+                out.pad(4 + 4 + 4);
+                bufferId++;
+
+                out.flushIfAbove(flushSize);
+            }
+        }
+        out.flush();
+        stream.close();
+
+        if (!stream) {
+            logE("SYNTH: Failed writing {}", path);
+            return false;
+        }
+
+        if (stats) {
+            stats->bytes = out.size();
+            stats->parts = parts;
+            stats->vertexBuffers = groups.size();
+            stats->indexBuffers = groups.size();
+            stats->textures = options.textures;
+        }
+        return true;
+    }
+
+    bool parseLayouts(std::string_view spec, std::vector<SynthLayout>& layouts) {
+        static const std::pair<std::string_view, MeshValType> valNames[] = {
+            {"position", MeshValType::Position},    {"normal", MeshValType::Normal},
+            {"color0", MeshValType::ColorSet0},     {"tangent", MeshValType::Tangent},
+            {"color1", MeshValType::ColorSet1},     {"uv1", MeshValType::UVSet1},
+            {"uv2", MeshValType::UVSet2},           {"blendindices", MeshValType::BlendIndices},
+            {"blendweight", MeshValType::BlendWeight}};
+        static const std::pair<std::string_view, MeshVarType> varNames[] = {
+            {"vec2f", MeshVarType::Vec2f},       {"vec3f", MeshVarType::Vec3f},       {"vec4f", MeshVarType::Vec4f},
+            {"vec2half", MeshVarType::Vec2half}, {"vec4half", MeshVarType::Vec4half}, {"vec4char", MeshVarType::Vec4char},
+            {"vec4mini", MeshVarType::Vec4mini}, {"col4char", MeshVarType::Col4char}};
+
+        layouts.clear();
+        for (auto layoutSpec : split(spec, ',')) {
+            auto& layout = layouts.emplace_back();
+            for (auto attribSpec : split(layoutSpec, '+')) {
+                auto colon = attribSpec.find(':');
+                if (colon == std::string_view::npos)
+                    return false;
+                auto valIt = std::find_if(std::begin(valNames), std::end(valNames),
+                                          [&](const auto& n) { return n.first == attribSpec.substr(0, colon); });
+                auto varIt = std::find_if(std::begin(varNames), std::end(varNames),
+                                          [&](const auto& n) { return n.first == attribSpec.substr(colon + 1); });
+                if (valIt == std::end(valNames) || varIt == std::end(varNames))
+                    return false;
+                layout.push_back({valIt->second, varIt->second});
+            }
+            if (layout.empty())
+                return false;
+        }
+        return !layouts.empty();
+    }
+
+    bool parseFormats(std::string_view spec, std::vector<TextureFormat>& formats) {
+        formats.clear();
+        for (auto name : split(spec, ',')) {
+            if (name == "dxt1")
+                formats.push_back(TextureFormat::DXT1);
+            else if (name == "dxt1a")
+                formats.push_back(TextureFormat::DXT1Alpha);
+            else if (name == "dxt5")
+                formats.push_back(TextureFormat::DXT5);
+            else if (name == "float")
+                formats.push_back(TextureFormat::FloatRGBA);
+            else
+                return false;
+        }
+        return !formats.empty();
+    }
+} // namespace synth
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "SceneData.hpp"
+#include "utils.hpp"
+
+struct SynthAttrib {
+    MeshValType val;
+    MeshVarType var;
+};
+using SynthLayout = std::vector<SynthAttrib>;
+
+struct SynthOptions {
+    int parts = 256;
+    // vertices of each part, rounded down to a square grid patch of at most 256x256
+    int partVertices = 4096;
+    // each new vertex buffer takes the next layout
+    std::vector<SynthLayout> layouts = {
+        {{MeshValType::Position, MeshVarType::Vec3f},
+         {MeshValType::Normal, MeshVarType::Vec4mini},
+         {MeshValType::ColorSet0, MeshVarType::Col4char},
+         {MeshValType::UVSet1, MeshVarType::Vec2half}},
+        {{MeshValType::Position, MeshVarType::Vec4half},
+         {MeshValType::Normal, MeshVarType::Vec4mini},
+         {MeshValType::UVSet1, MeshVarType::Vec4half},
+         {MeshValType::Tangent, MeshVarType::Vec4mini}},
+    };
+    // chance of a part being cut from the previous part's vertex and index buffers instead of getting its own
+    float sharedRatio = 0.5f;
+    // materials only reference textures from index 3 on, like in the games
+    int textures = 16;
+    int textureSize = 256;
+    int textureMips = 0; // 0 for a full chain
+    // textures cycle through these
+    std::vector<TextureFormat> textureFormats = {TextureFormat::DXT1, TextureFormat::DXT5};
+    int umtlVersion = 0x96;
+    // when set, `parts` is recomputed so the file ends up close to this many bytes
+    uint64_t targetSize = 0;
+    uint32_t seed = 1;
+};
+
+struct SynthStats {
+    uint64_t bytes = 0;
+    int parts = 0;
+    int vertexBuffers = 0;
+    int indexBuffers = 0;
+    int textures = 0;
+};
+
+namespace synth {
+    // Writes a .gsc/.ghg-shaped file SceneParser reads back: TXGH, DISP v15, UMTL, the DDS blobs and MESH.
+    // Parts are displaced grid patches laid out side by side, texture payloads are noise. Written as it's
+    // generated, so even multi-GB files only need a few MB of memory
+    bool writeScene(const std::string& path, const SynthOptions& options, SynthStats* stats = nullptr);
+    // "position:vec3f+normal:vec4mini+color0:col4char+uv1:vec2half", several layouts separated by ','
+    bool parseLayouts(std::string_view spec, std::vector<SynthLayout>& layouts);
+    // "dxt1,dxt1a,dxt5,float"
+    bool parseFormats(std::string_view spec, std::vector<TextureFormat>& formats);
+} // namespace synth
@@ -0,0 +1,97 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned int threadCount) : m_stopping(false) {
+    threadCount = std::max(1u, threadCount);
+    for (auto i = 0u; i < threadCount; i++) {
+        m_threads.emplace_back(&ThreadPool::worker, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cv.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::worker() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(m_mutex);
+            m_cv.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+            if (m_stopping && m_tasks.empty())
+                return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t, size_t)>& func, size_t grain) {
+    if (count == 0)
+        return;
+
+    grain = std::max<size_t>(1, grain);
+    // a few chunks per thread so uneven items still balance out
+    auto chunkSize = std::max(grain, count / (size() * 4 + 1) + 1);
+    auto chunkCount = (count + chunkSize - 1) / chunkSize;
+
+    if (chunkCount == 1) {
+        func(0, count);
+        return;
+    }
+
+    // helpers may only get scheduled after we've returned, so everything they touch is shared
+    struct State {
+        std::function<void(size_t, size_t)> func;
+        std::atomic<size_t> next;
+        size_t done;
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+    auto state = std::make_shared<State>();
+    state->func = func;
+    state->next = 0;
+    state->done = 0;
+
+    auto run = [state, count, chunkSize, chunkCount]() {
+        while (true) {
+            auto chunk = state->next.fetch_add(1);
+            if (chunk >= chunkCount)
+                return;
+            auto begin = chunk * chunkSize;
+            state->func(begin, std::min(count, begin + chunkSize));
+            std::lock_guard lock(state->mutex);
+            if (++state->done == chunkCount)
+                state->cv.notify_all();
+        }
+    };
+
+    auto helpers = std::min<size_t>(size(), chunkCount - 1);
+    {
+        std::lock_guard lock(m_mutex);
+        for (auto i = 0u; i < helpers; i++) {
+            m_tasks.emplace(run);
+        }
+    }
+    m_cv.notify_all();
+
+    run();
+
+    std::unique_lock lock(state->mutex);
+    state->cv.wait(lock, [&]() { return state->done == chunkCount; });
+}
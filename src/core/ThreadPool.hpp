@@ -0,0 +1,46 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+  public:
+    explicit ThreadPool(unsigned int threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    // process-wide pool, created on first use
+    static ThreadPool& shared();
+
+    template <typename F>
+    auto submit(F&& func) -> std::future<decltype(func())> {
+        using R = decltype(func());
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+        auto future = task->get_future();
+        {
+            std::lock_guard lock(m_mutex);
+            m_tasks.emplace([task]() { (*task)(); });
+        }
+        m_cv.notify_one();
+        return future;
+    }
+
+    // splits [0, count) into chunks of at least `grain` items and runs `func(begin, end)` on them.
+    // The calling thread takes part too, so calling this from inside a pool task is fine
+    void parallelFor(size_t count, const std::function<void(size_t, size_t)>& func, size_t grain = 1);
+
+    unsigned int size() const { return m_threads.size(); }
+
+  private:
+    void worker();
+
+    std::vector<std::thread> m_threads;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stopping;
+};
@@ -0,0 +1,160 @@
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "logger.hpp"
+
+namespace trace {
+    namespace {
+        using Clock = std::chrono::steady_clock;
+
+        struct Event {
+            const char* name;
+            int64_t start; // ns since start()
+            int64_t duration;
+            size_t bytes;
+        };
+
+        // one per thread that ever recorded, so scopes only contend with write()
+        struct ThreadEvents {
+            int tid;
+            std::mutex mutex;
+            std::vector<Event> events;
+        };
+
+        std::atomic<bool> g_recording = false;
+        Clock::time_point g_epoch;
+        std::mutex g_threadsMutex;
+        std::vector<std::unique_ptr<ThreadEvents>> g_threads;
+
+        thread_local ThreadEvents* t_events = nullptr;
+        thread_local Scope* t_scope = nullptr;
+
+        int64_t now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - g_epoch).count();
+        }
+
+        ThreadEvents& threadEvents() {
+            if (!t_events) {
+                std::lock_guard lock(g_threadsMutex);
+                g_threads.push_back(std::make_unique<ThreadEvents>());
+                g_threads.back()->tid = g_threads.size();
+                t_events = g_threads.back().get();
+            }
+            return *t_events;
+        }
+    } // namespace
+
+    void start() {
+        if (!compiledIn)
+            logW("TRACE: Built without NUEX_TRACE, nothing will be recorded");
+        std::lock_guard lock(g_threadsMutex);
+        for (auto& thread : g_threads) {
+            std::lock_guard threadLock(thread->mutex);
+            thread->events.clear();
+        }
+        g_epoch = Clock::now();
+        g_recording = true;
+    }
+
+    void stop() {
+        g_recording = false;
+    }
+
+    bool write(const std::string& path) {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) {
+            logE("TRACE: Couldn't write {}", path);
+            return false;
+        }
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"NuExplorer\"}}";
+        std::lock_guard lock(g_threadsMutex);
+        for (auto& thread : g_threads) {
+            std::lock_guard threadLock(thread->mutex);
+            out << fmt::format(",\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"thread {}\"}}}}",
+                               thread->tid, thread->tid);
+            for (const auto& event : thread->events) {
+                out << fmt::format(",\n{{\"name\":\"{}\",\"cat\":\"load\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}",
+                                   event.name, thread->tid, event.start / 1e3, event.duration / 1e3);
+                if (event.bytes > 0)
+                    out << fmt::format(",\"args\":{{\"bytes\":{}}}", event.bytes);
+                out << "}";
+            }
+        }
+        out << "\n]}\n";
+        return (bool)out;
+    }
+
+    void printSummary() {
+        struct Phase {
+            const char* name;
+            size_t count = 0;
+            int64_t duration = 0;
+            size_t bytes = 0;
+        };
+        std::unordered_map<std::string_view, Phase> phases;
+
+        {
+            std::lock_guard lock(g_threadsMutex);
+            for (auto& thread : g_threads) {
+                std::lock_guard threadLock(thread->mutex);
+                for (const auto& event : thread->events) {
+                    auto& phase = phases[event.name];
+                    phase.name = event.name;
+                    phase.count++;
+                    phase.duration += event.duration;
+                    phase.bytes += event.bytes;
+                }
+            }
+        }
+
+        std::vector<Phase> sorted;
+        for (const auto& [name, phase] : phases) {
+            sorted.push_back(phase);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const Phase& a, const Phase& b) { return a.duration > b.duration; });
+
+        // nested scopes are part of their parents' time, parallel ones add up
+        fmt::print("{:<24} {:>8} {:>12} {:>10} {:>10}\n", "phase", "count", "total ms", "MB", "MB/s");
+        for (const auto& phase : sorted) {
+            auto ms = phase.duration / 1e6;
+            fmt::print("{:<24} {:>8} {:>12.2f}", phase.name, phase.count, ms);
+            if (phase.bytes > 0 && phase.duration > 0)
+                fmt::print(" {:>10.2f} {:>10.1f}", phase.bytes / 1e6, phase.bytes / 1e6 / (ms / 1e3));
+            fmt::print("\n");
+        }
+    }
+
+    void addBytes(size_t bytes) {
+        if (t_scope)
+            t_scope->m_bytes += bytes;
+    }
+
+    Scope::Scope(const char* name) : m_name(nullptr), m_start(0), m_bytes(0), m_parent(nullptr) {
+        if (!g_recording.load(std::memory_order_relaxed))
+            return;
+        m_name = name;
+        m_parent = t_scope;
+        t_scope = this;
+        m_start = now();
+    }
+
+    Scope::~Scope() {
+        if (!m_name)
+            return;
+        auto end = now();
+        t_scope = m_parent;
+
+        auto& thread = threadEvents();
+        std::lock_guard lock(thread.mutex);
+        thread.events.push_back({m_name, m_start, end - m_start, m_bytes});
+    }
+} // namespace trace
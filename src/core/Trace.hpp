@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string>
+
+// Scoped timers for the load pipeline, written as Chrome trace-event JSON (about:tracing, ui.perfetto.dev).
+// Only built with -DNUEX_TRACE (the NUEX_TRACE CMake option); otherwise the macros expand to nothing and
+// their arguments aren't evaluated. Scopes record only between start() and stop(), on any thread.
+//
+//   NUEX_TRACE_SCOPE("loadVertices");
+//   ...
+//   NUEX_TRACE_BYTES(size); // counted towards the innermost scope on this thread, for the MB/s summary
+//   NUEX_TRACE_READER_SCOPE("part", reader); // counts the bytes the reader moved through
+
+namespace trace {
+#ifdef NUEX_TRACE
+    constexpr bool compiledIn = true;
+#else
+    constexpr bool compiledIn = false;
+#endif
+
+    // clears what was recorded and starts recording
+    void start();
+    void stop();
+    bool write(const std::string& path);
+    // per scope name: count, summed time over all threads, bytes and MB/s
+    void printSummary();
+
+    void addBytes(size_t bytes);
+
+    class Scope {
+      public:
+        // `name` must outlive the trace, string literals only
+        explicit Scope(const char* name);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        bool recording() const { return m_name; }
+
+      private:
+        friend void addBytes(size_t bytes);
+
+        const char* m_name;
+        int64_t m_start;
+        size_t m_bytes;
+        Scope* m_parent;
+    };
+
+    // counts what a reader (anything with pos()) went through in the scope
+    template <typename Reader>
+    class ReaderScope : public Scope {
+      public:
+        ReaderScope(const char* name, Reader& reader) : Scope(name), m_reader(reader), m_start(recording() ? reader.pos() : 0) {}
+        ~ReaderScope() {
+            if (recording() && std::uncaught_exceptions() == 0)
+                addBytes(m_reader.pos() - m_start);
+        }
+
+      private:
+        Reader& m_reader;
+        size_t m_start;
+    };
+} // namespace trace
+
+#ifdef NUEX_TRACE
+#define NUEX_TRACE_CONCAT_(a, b) a##b
+#define NUEX_TRACE_CONCAT(a, b) NUEX_TRACE_CONCAT_(a, b)
+#define NUEX_TRACE_SCOPE(name) trace::Scope NUEX_TRACE_CONCAT(traceScope, __LINE__)(name)
+#define NUEX_TRACE_READER_SCOPE(name, reader) trace::ReaderScope NUEX_TRACE_CONCAT(traceScope, __LINE__)(name, reader)
+#define NUEX_TRACE_BYTES(bytes) trace::addBytes(bytes)
+#else
+#define NUEX_TRACE_SCOPE(name)                                                                                                   \
+    do {                                                                                                                         \
+    } while (0)
+#define NUEX_TRACE_READER_SCOPE(name, reader)                                                                                    \
+    do {                                                                                                                         \
+    } while (0)
+#define NUEX_TRACE_BYTES(bytes)                                                                                                  \
+    do {                                                                                                                         \
+    } while (0)
+#endif
@@ -0,0 +1,115 @@
+#include "logger.hpp"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace logger {
+    namespace {
+        constexpr size_t capacity = 4096;
+
+        struct Entry {
+            Level level;
+            std::string text;
+        };
+
+        // fixed ring of lines, drained in batches by one thread that does the styling and the stdout writes
+        class Sink {
+          public:
+            Sink() : m_ring(capacity) {
+                m_thread = std::thread([this]() { run(); });
+                m_thread.detach();
+            }
+
+            void push(Level level, std::string text) {
+                std::unique_lock lock(m_mutex);
+                m_notFull.wait(lock, [this]() { return m_count < capacity; });
+                m_ring[(m_head + m_count) % capacity] = {level, std::move(text)};
+                m_count++;
+                m_pushed++;
+                lock.unlock();
+                m_notEmpty.notify_one();
+            }
+
+            void flush() {
+                std::unique_lock lock(m_mutex);
+                auto target = m_pushed;
+                m_drained.wait(lock, [this, target]() { return m_written >= target; });
+            }
+
+          private:
+            void run() {
+                std::vector<Entry> batch;
+                std::string out;
+                while (true) {
+                    {
+                        std::unique_lock lock(m_mutex);
+                        m_notEmpty.wait(lock, [this]() { return m_count > 0; });
+                        while (m_count > 0) {
+                            batch.push_back(std::move(m_ring[m_head]));
+                            m_head = (m_head + 1) % capacity;
+                            m_count--;
+                        }
+                    }
+                    m_notFull.notify_all();
+
+                    out.clear();
+                    for (const auto& entry : batch) {
+                        switch (entry.level) {
+                        case Level::Debug:
+                            out += fmt::format("[DEBUG] {}\n", entry.text);
+                            break;
+                        case Level::Warn:
+                            out += fmt::format(fg(fmt::terminal_color::yellow), "[WARN]  {}\n", entry.text);
+                            break;
+                        default:
+                            out += fmt::format(fmt::emphasis::bold | fg(fmt::terminal_color::red), "[ERROR] {}\n", entry.text);
+                            break;
+                        }
+                    }
+                    std::fwrite(out.data(), 1, out.size(), stdout);
+                    std::fflush(stdout);
+
+                    {
+                        std::lock_guard lock(m_mutex);
+                        m_written += batch.size();
+                    }
+                    m_drained.notify_all();
+                    batch.clear();
+                }
+            }
+
+            std::mutex m_mutex;
+            std::condition_variable m_notEmpty;
+            std::condition_variable m_notFull;
+            std::condition_variable m_drained;
+            std::vector<Entry> m_ring;
+            size_t m_head = 0;
+            size_t m_count = 0;
+            uint64_t m_pushed = 0;
+            uint64_t m_written = 0;
+            std::thread m_thread;
+        };
+
+        // never destroyed, so logging from other static destructors stays safe
+        Sink& sink() {
+            static auto* instance = []() {
+                auto* sink = new Sink();
+                std::atexit([]() { logger::flush(); });
+                return sink;
+            }();
+            return *instance;
+        }
+    } // namespace
+
+    void write(Level l, std::string message) {
+        sink().push(l, std::move(message));
+    }
+
+    void flush() {
+        sink().flush();
+    }
+} // namespace logger
@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <fmt/format.h>
+#include <fmt/color.h>
+
+// levels below NUEX_LOG_MIN_LEVEL aren't compiled in at all, e.g. -DNUEX_LOG_MIN_LEVEL=1 drops every logD
+#ifndef NUEX_LOG_MIN_LEVEL
+#define NUEX_LOG_MIN_LEVEL 0
+#endif
+
+namespace logger {
+    enum class Level {
+        Debug,
+        Warn,
+        Error,
+        Off
+    };
+
+    // runtime filter, batch runs raise it to Warn so the parser's chatter doesn't bury the report
+    inline std::atomic<Level> level = Level::Debug;
+
+    inline bool enabled(Level l) {
+        return (int)l >= NUEX_LOG_MIN_LEVEL && l >= level.load(std::memory_order_relaxed);
+    }
+
+    // queues a formatted line for the writer thread, blocks only while its ring buffer is full
+    void write(Level l, std::string message);
+    // returns once everything queued so far is on stdout. Also runs at exit
+    void flush();
+} // namespace logger
+
+// arguments are only evaluated (and formatted, once) when the level is enabled
+#define NUEX_LOG(lvl, ...)                                                                                                       \
+    do {                                                                                                                         \
+        if (logger::enabled(lvl))                                                                                                \
+            logger::write(lvl, fmt::format(__VA_ARGS__));                                                                        \
+    } while (0)
+#define logD(...) NUEX_LOG(logger::Level::Debug, __VA_ARGS__)
+#define logW(...) NUEX_LOG(logger::Level::Warn, __VA_ARGS__)
+#define logE(...) NUEX_LOG(logger::Level::Error, __VA_ARGS__)
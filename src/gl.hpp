@@ -0,0 +1,5 @@
+#pragma once
+// raylib already loads every GL entry point through its bundled glad, so we reuse those
+// pointers for the few calls rlgl doesn't wrap (queries, indirect draws, etc)
+#include <external/glad.h>
+#include <rlgl.h>
@@ -1,10 +1,16 @@
+#include <filesystem>
+#include <string_view>
 #include <raylib.h>
 #include <raygui.h>
 #include <dark/style_dark.h>
 #include <rlFPCamera.h>
 #include <tinyfiledialogs.h>
+#include "Batch.hpp"
+#include "GltfExporter.hpp"
 #include "types.hpp"
 #include "Scene.hpp"
+#include "SynthScene.hpp"
+#include "Trace.hpp"
 #include "logger.hpp"
 
 Color intToColor(int col) {
@@ -13,18 +19,91 @@ Color intToColor(int col) {
 }
 
 void rlLogCallback(int logLevel, const char* text, va_list args) {
+    auto level = logLevel <= LOG_INFO ? logger::Level::Debug : (logLevel == LOG_WARNING ? logger::Level::Warn : logger::Level::Error);
+    // filtered before vsnprintf, raylib's chatter shares the logger's sink and levels
+    if (logLevel >= LOG_NONE || !logger::enabled(level))
+        return;
     char buffer[1024];
     vsnprintf(buffer, 1024, text, args);
-    if (logLevel <= LOG_INFO) {
-        logD("[RL] {}", buffer);
-    } else if (logLevel == LOG_WARNING) {
-        logW("[RL] {}", buffer);
-    } else if (logLevel == LOG_ERROR || logLevel == LOG_FATAL) {
-        logE("[RL] {}", buffer);
-    }
+    logger::write(level, fmt::format("[RL] {}", buffer));
 }
 
-int main() {
+int main(int argc, char** argv) {
+    if (argc >= 2 && std::string_view(argv[1]) == "--batch") {
+        BatchOptions options;
+        for (auto i = 2; i < argc; i++) {
+            auto arg = std::string_view(argv[i]);
+            if (arg == "--export" && i + 1 < argc) {
+                options.exportDir = argv[++i];
+            } else if (arg == "--png") {
+                options.pngTextures = true;
+            } else if (arg == "--trace" && i + 1 < argc) {
+                options.tracePath = argv[++i];
+            } else if (options.dir.empty()) {
+                options.dir = arg;
+            } else {
+                options.dir.clear();
+                break;
+            }
+        }
+        if (options.dir.empty()) {
+            logE("Usage: {} --batch <dir> [--export <outdir> [--png]] [--trace <out.json>]", argv[0]);
+            return 2;
+        }
+        return batch::run(options);
+    }
+
+    if (argc >= 2 && std::string_view(argv[1]) == "--synth") {
+        // the output path comes first, anything looking like a flag there is `--help` or a mistake
+        auto help = argc < 3 || std::string_view(argv[2]).starts_with("--");
+        SynthOptions options;
+        auto valid = !help;
+        for (auto i = 3; i + 1 < argc && valid; i += 2) {
+            auto arg = std::string_view(argv[i]);
+            auto value = argv[i + 1];
+            if (arg == "--parts")
+                options.parts = std::atoi(value);
+            else if (arg == "--vertices")
+                options.partVertices = std::atoi(value);
+            else if (arg == "--layouts")
+                valid = synth::parseLayouts(value, options.layouts);
+            else if (arg == "--shared")
+                options.sharedRatio = std::atof(value);
+            else if (arg == "--textures")
+                options.textures = std::atoi(value);
+            else if (arg == "--texture-size")
+                options.textureSize = std::atoi(value);
+            else if (arg == "--formats")
+                valid = synth::parseFormats(value, options.textureFormats);
+            else if (arg == "--umtl")
+                options.umtlVersion = std::strtol(value, nullptr, 0);
+            else if (arg == "--size-mb")
+                options.targetSize = std::strtoull(value, nullptr, 10) * 1024 * 1024;
+            else if (arg == "--seed")
+                options.seed = std::atoi(value);
+            else
+                valid = false;
+        }
+        if (!valid || argc % 2 == 0) {
+            logE("Usage: {} --synth <out.gsc> [--parts <n>] [--vertices <per part>] [--layouts <spec>] [--shared <0..1>] "
+                 "[--textures <n>] [--texture-size <px>] [--formats dxt1,dxt1a,dxt5,float] [--umtl 0x94|0x95|0x96] "
+                 "[--size-mb <n>] [--seed <n>]",
+                 argv[0]);
+            return help && argc == 3 && std::string_view(argv[2]) == "--help" ? 0 : 2;
+        }
+        SynthStats stats;
+        if (!synth::writeScene(argv[2], options, &stats))
+            return 1;
+        fmt::print("Wrote {}: {:.1f} MB, {} parts over {} vertex buffers, {} textures\n", argv[2], stats.bytes / 1e6, stats.parts,
+                   stats.vertexBuffers, stats.textures);
+        return 0;
+    }
+
+    // `--trace <out.json>` traces every load, the file is overwritten each time
+    std::string tracePath;
+    if (argc >= 3 && std::string_view(argv[1]) == "--trace")
+        tracePath = argv[2];
+
     // SetTraceLogLevel(LOG_INFO);
     SetTraceLogLevel(LOG_WARNING);
     SetTraceLogCallback(rlLogCallback);
@@ -46,7 +125,8 @@ int main() {
 
     Scene scene;
 
-    bool sceneLoaded = false;
+    std::string loadedFile; // the last one, what X exports
+    std::string loadError; // shown until the next load
 
     auto borderColor = intToColor(GuiGetStyle(DEFAULT, BORDER_COLOR_NORMAL));
     auto mainColor = intToColor(GuiGetStyle(DEFAULT, BASE_COLOR_NORMAL));
@@ -63,16 +143,106 @@ int main() {
         if (IsKeyPressed(KEY_O)) {
             logD("Open key pressed");
             const char* filterPatterns[] = {"*.gsc;*.ghg"};
-            auto name = tinyfd_openFileDialog("Select an object file (tested on LLOTR only!)", nullptr, 1, filterPatterns,
-                                              "Game object files (.gsc, .ghg)", false);
+            // files are added to what's loaded, several can be picked at once
+            auto selection = tinyfd_openFileDialog("Select object files (tested on LLOTR only!)", nullptr, 1, filterPatterns,
+                                                   "Game object files (.gsc, .ghg)", true);
+            if (selection) {
+                logD("Selected {}", selection);
+                std::vector<std::string> names;
+                std::string_view rest = selection;
+                while (!rest.empty()) {
+                    auto end = std::min(rest.find('|'), rest.size());
+                    names.emplace_back(rest.substr(0, end));
+                    rest.remove_prefix(std::min(end + 1, rest.size()));
+                }
+
+                auto wasEmpty = scene.empty();
+                std::vector<LoadFailure> failures;
+                if (!tracePath.empty())
+                    trace::start();
+                scene.load(names, &failures);
+                if (!tracePath.empty()) {
+                    trace::stop();
+                    trace::write(tracePath);
+                    trace::printSummary();
+                }
+                loadError.clear();
+                for (const auto& failure : failures) {
+                    auto name = std::filesystem::path(failure.filename).filename().string();
+                    if (!loadError.empty())
+                        loadError += "\n";
+                    loadError += fmt::format("Couldn't load {}: {}", name, failure.error.message());
+                }
+                if (!scene.empty())
+                    loadedFile = scene.files().back();
+                if (wasEmpty)
+                    cam.SetCameraPosition({0, 0, 0});
+            }
+        }
+
+        if (IsKeyPressed(KEY_U) && !scene.empty()) {
+            scene.unload(scene.files().back());
+            loadedFile = scene.empty() ? "" : scene.files().back();
+        }
+
+        if (IsKeyPressed(KEY_X) && !scene.empty()) {
+            const char* filterPatterns[] = {"*.glb"};
+            auto defaultName = std::filesystem::path(loadedFile).replace_extension(".glb").string();
+            auto name = tinyfd_saveFileDialog("Export as glTF", defaultName.c_str(), 1, filterPatterns, "glTF binary (.glb)");
             if (name) {
-                sceneLoaded = true;
-                logD("Selected file {}", name);
-                scene.load(name);
-                cam.SetCameraPosition({0, 0, 0});
+                logD("Exporting to {}", name);
+                gltf::exportFile(loadedFile, name);
             }
         }
 
+        if (IsKeyPressed(KEY_F1)) {
+            scene.settings().occlusionCulling = !scene.settings().occlusionCulling;
+            logD("Occlusion culling: {}", scene.settings().occlusionCulling);
+        }
+        if (IsKeyPressed(KEY_F2)) {
+            scene.settings().meshletCulling = !scene.settings().meshletCulling;
+            logD("Meshlet culling: {}", scene.settings().meshletCulling);
+        }
+        if (IsKeyPressed(KEY_F3)) {
+            scene.settings().sortedQueue = !scene.settings().sortedQueue;
+            logD("Sorted render queue: {}", scene.settings().sortedQueue);
+        }
+        if (IsKeyPressed(KEY_F4)) {
+            scene.settings().leanDrawPath = !scene.settings().leanDrawPath;
+            logD("Lean draw path: {}", scene.settings().leanDrawPath);
+        }
+        if (IsKeyPressed(KEY_F5)) {
+            scene.settings().indirectDraw = !scene.settings().indirectDraw;
+            logD("Multi-draw indirect: {}", scene.settings().indirectDraw);
+        }
+        if (IsKeyPressed(KEY_F6)) {
+            scene.settings().gpuCulling = !scene.settings().gpuCulling;
+            logD("GPU culling: {}", scene.settings().gpuCulling);
+        }
+        if (IsKeyPressed(KEY_F7)) {
+            scene.settings().textureArrays = !scene.settings().textureArrays;
+            logD("Texture arrays: {}", scene.settings().textureArrays);
+        }
+        if (IsKeyPressed(KEY_F8)) {
+            scene.settings().streamTextures = !scene.settings().streamTextures;
+            logD("Texture streaming: {} (applied on the next load)", scene.settings().streamTextures);
+        }
+        if (IsKeyPressed(KEY_F9)) {
+            scene.settings().lazyTextures = !scene.settings().lazyTextures;
+            logD("Lazy textures: {} (applied on the next load)", scene.settings().lazyTextures);
+        }
+        if (IsKeyPressed(KEY_F10)) {
+            scene.settings().lazyGeometry = !scene.settings().lazyGeometry;
+            logD("Lazy geometry: {} (applied on the next load)", scene.settings().lazyGeometry);
+        }
+        if (IsKeyPressed(KEY_LEFT_BRACKET) || IsKeyPressed(KEY_RIGHT_BRACKET)) {
+            auto& budget = scene.settings().vramBudgetMB;
+            budget = IsKeyPressed(KEY_RIGHT_BRACKET) ? std::min(budget * 2, 65536) : std::max(budget / 2, 64);
+            logD("VRAM budget: {} MB", budget);
+        }
+
+        scene.update();
+
         BeginDrawing();
 
         cam.Update();
@@ -87,8 +257,8 @@ int main() {
         DrawRay({{0, 0, 0}, {0, 1, 0}}, GREEN); // y
         DrawRay({{0, 0, 0}, {0, 0, 1}}, BLUE);  // z
 
-        if (sceneLoaded)
-            scene.render();
+        if (!scene.empty())
+            scene.render(cam.GetCamera());
 
         cam.EndMode3D();
 
@@ -100,6 +270,60 @@ int main() {
         DrawText(camSpeed.c_str(), 0, 20, 20, GREEN);
         auto camPos = cam.GetCameraPosition();
         DrawText(fmt::format("Cam pos: {} {} {}", camPos.x, camPos.y, camPos.z).c_str(), 0, 40, 20, GREEN);
+        const auto& stats = scene.stats();
+        auto hudY = 60;
+        auto hudLine = [&hudY](const std::string& text) {
+            DrawText(text.c_str(), 0, hudY, 20, GREEN);
+            hudY += 20;
+        };
+        if (!scene.empty()) {
+            auto files = scene.files();
+            hudLine(fmt::format("Files: {} loaded, last {} (U unloads it)", files.size(),
+                                std::filesystem::path(files.back()).filename().string()));
+        }
+        if (stats.indirect) {
+            if (scene.settings().gpuCulling) {
+                hudLine(fmt::format("Indirect: {} multi-draws{}, culled on the GPU", stats.indirectDraws,
+                                    scene.settings().textureArrays ? " over texture arrays" : ""));
+            } else {
+                hudLine(fmt::format("Indirect: {} multi-draws{}, {} parts visible", stats.indirectDraws,
+                                    scene.settings().textureArrays ? " over texture arrays" : "", stats.drawn));
+            }
+        } else if (scene.settings().occlusionCulling) {
+            hudLine(fmt::format("Occlusion: {} queried, {} occluded, {} drawn", stats.queried, stats.occluded, stats.drawn));
+        } else {
+            hudLine(fmt::format("Occlusion: off, {} drawn", stats.drawn));
+        }
+        if (scene.settings().meshletCulling && !stats.indirect) {
+            hudLine(fmt::format("Meshlets: {} of {} visible", stats.meshletsVisible, stats.meshlets));
+        }
+        if (scene.settings().sortedQueue && !stats.indirect) {
+            hudLine(fmt::format("Queue: {} sorted, {} outside frustum", stats.queued, stats.frustumCulled));
+        }
+        auto drawPath = stats.indirect ? "indirect" : (scene.settings().leanDrawPath ? "lean" : "DrawModel");
+        hudLine(fmt::format("Draw path: {}, {:.0f} draws/s", drawPath, stats.drawsPerSecond));
+        if (stats.streaming.textures > 0) {
+            hudLine(fmt::format("Streaming: {:.1f}/{} MB, {} textures, {} loading, {} uploads, {} evictions",
+                                stats.streaming.residentBytes / (1024.0 * 1024.0), scene.settings().textureBudgetMB,
+                                stats.streaming.textures, stats.streaming.loading, stats.streaming.uploads,
+                                stats.streaming.evictions));
+        }
+        if (stats.lazy.textures > 0) {
+            hudLine(fmt::format("Lazy textures: {}/{} resident, {} decoding, {} loads, {} evictions", stats.lazy.resident,
+                                stats.lazy.textures, stats.lazy.decoding, stats.lazy.loads, stats.lazy.evictions));
+        }
+        if (stats.geometry.parts > 0) {
+            hudLine(fmt::format("Lazy geometry: {}/{} parts resident, {} decoding, {} loads", stats.geometry.resident,
+                                stats.geometry.parts, stats.geometry.decoding, stats.geometry.loads));
+        }
+        if (stats.residency.residentBytes > 0) {
+            hudLine(fmt::format("VRAM: {:.1f}/{} MB ({:.1f} MB pinned), {} evictable resident, {} evictions, {} reloads",
+                                stats.residency.residentBytes / (1024.0 * 1024.0), scene.settings().vramBudgetMB,
+                                stats.residency.pinnedBytes / (1024.0 * 1024.0), stats.residency.resident,
+                                stats.residency.evictions, stats.residency.reloads));
+        }
+        if (!loadError.empty())
+            DrawText(loadError.c_str(), 0, hudY, 20, RED);
 
         EndDrawing();
     }